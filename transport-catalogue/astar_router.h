@@ -0,0 +1,162 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Point-to-point A*: Potential is a callable Weight(VertexId vertex, VertexId to) giving a lower bound
+// of the route weight from vertex to to. With an admissible potential routes are the shortest ones;
+// vertices are reopened when a shorter route to them turns up, so consistency isn't required.
+// The graph must be frozen.
+template <typename Weight, typename Potential>
+class AStarRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    AStarRouter(const Graph& graph, Potential potential);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    static constexpr EdgeId NONE_EDGE = std::numeric_limits<EdgeId>::max();
+
+    struct QueueItem {
+        Weight estimation;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return estimation > other.estimation;
+        }
+    };
+
+    // per-thread buffers, valid for a vertex only when its stamp equals the current query stamp;
+    // the potential is computed once per reached vertex
+    struct SearchData {
+        std::vector<Weight> weights;
+        std::vector<Weight> potentials;
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> stamps;
+        std::vector<QueueItem> queue;
+        uint32_t stamp = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                potentials.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+            }
+            queue.clear();
+            if (++stamp == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                stamp = 1;
+            }
+        }
+
+        QueueItem Pop() {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            const QueueItem item = queue.back();
+            queue.pop_back();
+            return item;
+        }
+    };
+
+    static SearchData& GetSearchData() {
+        static thread_local SearchData search_data;
+        return search_data;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    Potential potential_;
+};
+
+template <typename Weight, typename Potential>
+AStarRouter<Weight, Potential>::AStarRouter(const Graph& graph, Potential potential)
+    : graph_(graph)
+    , potential_(std::move(potential))
+{
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t edge_count = graph.GetEdgeCount();
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight, typename Potential>
+std::optional<typename AStarRouter<Weight, Potential>::RouteInfo>
+AStarRouter<Weight, Potential>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+
+    SearchData& data = GetSearchData();
+    data.Prepare(vertex_count);
+
+    const auto reach = [this, &data, to](VertexId vertex, Weight weight, EdgeId prev_edge) {
+        if (data.stamps[vertex] != data.stamp) {
+            data.stamps[vertex] = data.stamp;
+            data.potentials[vertex] = potential_(vertex, to);
+        }
+        data.weights[vertex] = weight;
+        data.prev_edges[vertex] = prev_edge;
+        data.queue.push_back({weight + data.potentials[vertex], weight, vertex});
+        std::push_heap(data.queue.begin(), data.queue.end(), std::greater<QueueItem>{});
+    };
+    reach(from, ZERO_WEIGHT, NONE_EDGE);
+
+    bool is_found = false;
+    while (!data.queue.empty()) {
+        const QueueItem item = data.Pop();
+        if (data.weights[item.vertex] < item.weight) {
+            continue; // outdated queue item
+        }
+        if (item.vertex == to) {
+            is_found = true;
+            break;
+        }
+        const auto arcs = graph_.GetOutgoingArcs(item.vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = item.weight + arcs.weights[idx];
+            if (data.stamps[next] != data.stamp || candidate_weight < data.weights[next]) {
+                reach(next, candidate_weight, arcs.edge_ids[idx]);
+            }
+        }
+    }
+
+    if (!is_found) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = data.prev_edges[to]; edge_id != NONE_EDGE;
+         edge_id = data.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{data.weights[to], std::move(edges)};
+}
+
+}  // namespace graph
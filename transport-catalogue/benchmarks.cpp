@@ -0,0 +1,636 @@
+#include "bidirectional_router.h"
+#include "dijkstra_router.h"
+#include "geo.h"
+#include "graph.h"
+#include "json_reader.h"
+#include "min_plus.h"
+#include "parallel.h"
+#include "router.h"
+#include "stop_index.h"
+#include "vertex_order.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+using namespace graph;
+
+namespace {
+
+constexpr std::mt19937::result_type SEED = 20240531;
+
+using Clock = std::chrono::steady_clock;
+
+// wall time of one call of func, in seconds
+template <typename Func>
+double MeasureSeconds(Func&& func) {
+    const auto start = Clock::now();
+    func();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// least wall time of repeat_count calls of func, in seconds
+template <typename Func>
+double MeasureBestSeconds(size_t repeat_count, Func&& func) {
+    double best_seconds = std::numeric_limits<double>::infinity();
+    for (size_t repeat = 0; repeat < repeat_count; ++repeat) {
+        best_seconds = std::min(best_seconds, MeasureSeconds(func));
+    }
+    return best_seconds;
+}
+
+// argument number index of a section, or default_value when it isn't given
+size_t GetArgument(int argc, char* argv[], int index, size_t default_value) {
+    return index < argc ? std::stoul(argv[index]) : default_value;
+}
+
+// 1, 2, 4... up to max_threads, which is always the last one
+std::vector<size_t> GetThreadCounts(size_t max_threads) {
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(std::max<size_t>(max_threads, 1));
+    return thread_counts;
+}
+
+// Road-like network: vertices are jittered points of a square grid with edges both ways between
+// grid neighbours, plus a few long express edges. Weights grow with the distance. Vertex ids are
+// shuffled, like the ids given in the order stops are met on routes.
+struct GeneratedGraph {
+    DirectedWeightedGraph<double> graph;
+    std::vector<std::pair<double, double>> points; // indexed by vertex id
+};
+
+GeneratedGraph GenerateGraph(size_t vertex_count, std::mt19937& engine) {
+    const size_t side = std::max<size_t>(static_cast<size_t>(std::ceil(std::sqrt(vertex_count))), 1);
+    std::uniform_real_distribution<double> jitter(-0.3, 0.3);
+    std::uniform_real_distribution<double> slowdown(1.0, 1.5);
+
+    std::vector<VertexId> ids(vertex_count);
+    std::iota(ids.begin(), ids.end(), 0);
+    std::shuffle(ids.begin(), ids.end(), engine);
+
+    GeneratedGraph generated{ DirectedWeightedGraph<double>(vertex_count), std::vector<std::pair<double, double>>(vertex_count) };
+    for (size_t position = 0; position < vertex_count; ++position) {
+        generated.points[ids[position]] = { position % side + jitter(engine), position / side + jitter(engine) };
+    }
+    const auto add_edges = [&](size_t from, size_t to, double speed) {
+        const auto [from_x, from_y] = generated.points[ids[from]];
+        const auto [to_x, to_y] = generated.points[ids[to]];
+        const double distance = std::hypot(to_x - from_x, to_y - from_y);
+        generated.graph.AddEdge({ ids[from], ids[to], distance * slowdown(engine) / speed });
+        generated.graph.AddEdge({ ids[to], ids[from], distance * slowdown(engine) / speed });
+    };
+    for (size_t position = 0; position < vertex_count; ++position) {
+        if ((position + 1) % side != 0 && position + 1 < vertex_count) {
+            add_edges(position, position + 1, 1.0);
+        }
+        if (position + side < vertex_count) {
+            add_edges(position, position + side, 1.0);
+        }
+    }
+    std::uniform_int_distribution<size_t> position_distribution(0, vertex_count - 1);
+    for (size_t express = 0; express < vertex_count / 20; ++express) {
+        add_edges(position_distribution(engine), position_distribution(engine), 3.0);
+    }
+    generated.graph.Freeze();
+    return generated;
+}
+
+// Floyd-Warshall table of a generated graph built on 1, 2, 4... threads. Every table must be
+// identical to the single-thread one.
+int BenchAllPairs(int argc, char* argv[]) {
+    const size_t vertex_count = GetArgument(argc, argv, 2, 5000);
+    const size_t max_threads = GetArgument(argc, argv, 3, parallel::GetThreadCount(0));
+
+    std::mt19937 engine(SEED);
+    const GeneratedGraph generated = GenerateGraph(vertex_count, engine);
+    std::cout << "all_pairs: "sv << vertex_count << " vertices, "sv << generated.graph.GetEdgeCount()
+              << " edges, kernel "sv << min_plus::GetKernelName() << '\n';
+
+    RoutesTable<double> serial_table;
+    double serial_seconds = 0;
+    bool is_identical = true;
+    for (const size_t threads : GetThreadCounts(max_threads)) {
+        RoutesTable<double> table;
+        const double seconds = MeasureSeconds([&] {
+            table = Router<double>::BuildRoutesTable(generated.graph, threads);
+        });
+        if (threads == 1) {
+            serial_seconds = seconds;
+            serial_table = std::move(table);
+        }
+        const bool is_same = threads == 1
+                             || (table.weights == serial_table.weights && table.prev_edges == serial_table.prev_edges);
+        is_identical = is_identical && is_same;
+        std::cout << std::setw(4) << threads << " threads: "sv << std::fixed << std::setprecision(3) << seconds
+                  << " s, speedup "sv << std::setprecision(2) << serial_seconds / seconds
+                  << (is_same ? ""sv : ", TABLE DIFFERS"sv) << '\n';
+    }
+    return is_identical ? 0 : 1;
+}
+
+// The row update as it was before the min-plus kernels: cells of optional routes with optional
+// last edges, relaxed one at a time
+struct OptionalRoute {
+    double weight;
+    std::optional<EdgeId> prev_edge;
+};
+using OptionalRoutes = std::vector<std::vector<std::optional<OptionalRoute>>>;
+
+void RelaxOptionalRoutes(OptionalRoutes& routes, VertexId vertex_through) {
+    const auto& routes_through = routes[vertex_through];
+    for (VertexId vertex_from = 0; vertex_from < routes.size(); ++vertex_from) {
+        if (vertex_from == vertex_through || !routes[vertex_from][vertex_through]) {
+            continue;
+        }
+        const OptionalRoute route_from = *routes[vertex_from][vertex_through];
+        auto& row = routes[vertex_from];
+        for (VertexId vertex_to = 0; vertex_to < row.size(); ++vertex_to) {
+            if (const auto& route_to = routes_through[vertex_to]) {
+                auto& route_relaxing = row[vertex_to];
+                const double candidate_weight = route_from.weight + route_to->weight;
+                if (!route_relaxing || candidate_weight < route_relaxing->weight) {
+                    route_relaxing = OptionalRoute{ candidate_weight,
+                                                    route_to->prev_edge ? route_to->prev_edge : route_from.prev_edge };
+                }
+            }
+        }
+    }
+}
+
+// Relaxes a vertex_count x vertex_count table of random routes through its first pivot_count
+// vertices, with min_plus::RelaxRow and with the optional-based loop. Both must give the same table.
+int BenchMinPlus(int argc, char* argv[]) {
+    const size_t vertex_count = GetArgument(argc, argv, 2, 2048);
+    const size_t pivot_count = std::min(GetArgument(argc, argv, 3, 64), vertex_count);
+
+    std::mt19937 engine(SEED);
+    std::bernoulli_distribution is_reachable(0.3);
+    std::uniform_real_distribution<double> weight_distribution(1.0, 100.0);
+    std::uniform_int_distribution<uint32_t> edge_distribution(0, 1u << 20);
+
+    RoutesTable<double> table;
+    table.vertex_count = vertex_count;
+    table.weights.assign(vertex_count * vertex_count, RoutesTable<double>::UNREACHABLE);
+    table.prev_edges.assign(vertex_count * vertex_count, RoutesTable<double>::NONE_EDGE);
+    OptionalRoutes optional_routes(vertex_count, std::vector<std::optional<OptionalRoute>>(vertex_count));
+    for (VertexId from = 0; from < vertex_count; ++from) {
+        for (VertexId to = 0; to < vertex_count; ++to) {
+            if (from == to) {
+                table.GetWeights(from)[to] = 0;
+                optional_routes[from][to] = OptionalRoute{ 0, std::nullopt };
+            } else if (is_reachable(engine)) {
+                const double weight = weight_distribution(engine);
+                const uint32_t edge_id = edge_distribution(engine);
+                table.GetWeights(from)[to] = weight;
+                table.GetPrevEdges(from)[to] = edge_id;
+                optional_routes[from][to] = OptionalRoute{ weight, edge_id };
+            }
+        }
+    }
+
+    const double kernel_seconds = MeasureSeconds([&] {
+        for (VertexId through = 0; through < pivot_count; ++through) {
+            for (VertexId from = 0; from < vertex_count; ++from) {
+                double* weights = table.GetWeights(from);
+                uint32_t* prev_edges = table.GetPrevEdges(from);
+                if (from == through || weights[through] == RoutesTable<double>::UNREACHABLE) {
+                    continue;
+                }
+                min_plus::RelaxRow(weights, prev_edges, weights[through], prev_edges[through],
+                                   table.GetWeights(through), table.GetPrevEdges(through), 0, vertex_count);
+            }
+        }
+    });
+    const double optional_seconds = MeasureSeconds([&] {
+        for (VertexId through = 0; through < pivot_count; ++through) {
+            RelaxOptionalRoutes(optional_routes, through);
+        }
+    });
+
+    bool is_identical = true;
+    for (VertexId from = 0; from < vertex_count; ++from) {
+        for (VertexId to = 0; to < vertex_count; ++to) {
+            const auto& route = optional_routes[from][to];
+            const double weight = route ? route->weight : RoutesTable<double>::UNREACHABLE;
+            const uint32_t prev_edge = route && route->prev_edge ? static_cast<uint32_t>(*route->prev_edge)
+                                                                 : RoutesTable<double>::NONE_EDGE;
+            is_identical = is_identical && table.GetWeights(from)[to] == weight
+                           && table.GetPrevEdges(from)[to] == prev_edge;
+        }
+    }
+
+    const double cell_count = static_cast<double>(vertex_count) * vertex_count * pivot_count;
+    std::cout << "min_plus: "sv << vertex_count << " x "sv << vertex_count << " table, "sv << pivot_count
+              << " pivots\n"sv << std::fixed << std::setprecision(3)
+              << std::setw(10) << min_plus::GetKernelName() << ": "sv << kernel_seconds * 1e9 / cell_count
+              << " ns per cell\n"sv
+              << std::setw(10) << "optional"sv << ": "sv << optional_seconds * 1e9 / cell_count << " ns per cell\n"sv
+              << "speedup "sv << std::setprecision(2) << optional_seconds / kernel_seconds
+              << (is_identical ? ""sv : ", TABLES DIFFER"sv) << '\n';
+    return is_identical ? 0 : 1;
+}
+
+// copy of graph with vertex v renumbered to new_ids[v]; edges keep their ids
+DirectedWeightedGraph<double> RenumberVertices(const DirectedWeightedGraph<double>& graph,
+                                               const std::vector<VertexId>& new_ids) {
+    DirectedWeightedGraph<double> renumbered(graph.GetVertexCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        renumbered.AddEdge({ new_ids[edge.from], new_ids[edge.to], edge.weight });
+    }
+    renumbered.Freeze();
+    return renumbered;
+}
+
+// Weights of the routes of queries, NaN for the missing ones, and the time per query in microseconds
+template <typename Engine>
+std::pair<std::vector<double>, double> AnswerQueries(const Engine& engine,
+                                                     const std::vector<std::pair<VertexId, VertexId>>& queries) {
+    std::vector<double> weights;
+    weights.reserve(queries.size());
+    const double seconds = MeasureSeconds([&] {
+        for (const auto& [from, to] : queries) {
+            const auto route = engine.BuildRoute(from, to);
+            weights.push_back(route ? route->weight : std::numeric_limits<double>::quiet_NaN());
+        }
+    });
+    return { std::move(weights), seconds * 1e6 / std::max<size_t>(queries.size(), 1) };
+}
+
+bool IsSameWeights(const std::vector<double>& lhs, const std::vector<double>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](double lhs_weight, double rhs_weight) {
+        return (std::isnan(lhs_weight) && std::isnan(rhs_weight))
+               || std::abs(lhs_weight - rhs_weight) <= 1e-9 * std::max(1.0, std::abs(lhs_weight));
+    });
+}
+
+// The generated graph numbered as generated, in Cuthill-McKee and in Hilbert order: time of the
+// all-pairs table and per query time of the Dijkstra and bidirectional engines. Generated ids are
+// shuffled, so "routes" stands for an order with no locality at all. Route weights must not depend
+// on the order.
+int BenchVertexOrder(int argc, char* argv[]) {
+    const size_t vertex_count = GetArgument(argc, argv, 2, 3000);
+    const size_t query_count = GetArgument(argc, argv, 3, 2000);
+
+    std::mt19937 engine(SEED);
+    const GeneratedGraph generated = GenerateGraph(vertex_count, engine);
+    std::uniform_int_distribution<VertexId> vertex_distribution(0, vertex_count - 1);
+    std::vector<std::pair<VertexId, VertexId>> queries(query_count);
+    for (auto& query : queries) {
+        query = { vertex_distribution(engine), vertex_distribution(engine) };
+    }
+    std::cout << "vertex_order: "sv << vertex_count << " vertices, "sv << generated.graph.GetEdgeCount()
+              << " edges, "sv << query_count << " queries\n"sv << std::fixed;
+
+    std::vector<VertexId> routes_ids(vertex_count);
+    std::iota(routes_ids.begin(), routes_ids.end(), 0);
+    const std::vector<std::pair<std::string_view, std::vector<VertexId>>> orders = {
+        { "routes"sv, std::move(routes_ids) },
+        { "cuthill_mckee"sv, ComputeCuthillMcKeeOrder(generated.graph) },
+        { "hilbert"sv, ComputeHilbertOrder(generated.points) },
+    };
+
+    std::vector<double> reference_weights;
+    bool is_identical = true;
+    for (const auto& [name, new_ids] : orders) {
+        const DirectedWeightedGraph<double> graph = RenumberVertices(generated.graph, new_ids);
+        std::vector<std::pair<VertexId, VertexId>> renumbered_queries;
+        renumbered_queries.reserve(queries.size());
+        for (const auto& [from, to] : queries) {
+            renumbered_queries.emplace_back(new_ids[from], new_ids[to]);
+        }
+
+        std::unique_ptr<Router<double>> all_pairs;
+        const double all_pairs_seconds = MeasureSeconds([&] {
+            all_pairs = std::make_unique<Router<double>>(graph);
+        });
+        const auto [all_pairs_weights, all_pairs_micros] = AnswerQueries(*all_pairs, renumbered_queries);
+        all_pairs.reset();
+        const auto [dijkstra_weights, dijkstra_micros] = AnswerQueries(DijkstraRouter<double>(graph), renumbered_queries);
+        const auto [bidirectional_weights, bidirectional_micros]
+            = AnswerQueries(BidirectionalRouter<double>(graph), renumbered_queries);
+
+        if (reference_weights.empty()) {
+            reference_weights = all_pairs_weights;
+        }
+        const bool is_same = IsSameWeights(all_pairs_weights, reference_weights)
+                             && IsSameWeights(dijkstra_weights, reference_weights)
+                             && IsSameWeights(bidirectional_weights, reference_weights);
+        is_identical = is_identical && is_same;
+        std::cout << std::setw(14) << name << ": all-pairs table "sv << std::setprecision(3) << all_pairs_seconds
+                  << " s, per query: table "sv << std::setprecision(2) << all_pairs_micros << " us, dijkstra "sv
+                  << dijkstra_micros << " us, bidirectional "sv << bidirectional_micros << " us"sv
+                  << (is_same ? ""sv : ", WEIGHTS DIFFER"sv) << '\n';
+    }
+    return is_identical ? 0 : 1;
+}
+
+// make_base input of a generated city: stops on a jittered grid over about 40 x 40 km and buses
+// which wander over neighbouring stops there and back
+std::string GenerateBaseRequests(size_t stop_count, const std::string& routing_settings,
+                                 const std::string& base_file, std::mt19937& engine) {
+    const size_t side = std::max<size_t>(static_cast<size_t>(std::ceil(std::sqrt(stop_count))), 1);
+    const double step = 0.4 / side;
+    std::uniform_real_distribution<double> jitter(-0.3 * step, 0.3 * step);
+    std::vector<geo::Coordinates> coordinates(stop_count);
+    for (size_t stop = 0; stop < stop_count; ++stop) {
+        coordinates[stop] = { 55.5 + stop / side * step + jitter(engine), 37.4 + stop % side * step + jitter(engine) };
+    }
+
+    std::vector<std::vector<size_t>> buses(stop_count / 10 + 1);
+    std::vector<std::map<size_t, int>> road_distances(stop_count);
+    std::uniform_int_distribution<size_t> stop_distribution(0, stop_count - 1);
+    std::uniform_int_distribution<size_t> length_distribution(8, 20);
+    std::uniform_int_distribution<int> direction_distribution(0, 3);
+    for (auto& bus : buses) {
+        bus.push_back(stop_distribution(engine));
+        for (size_t length = length_distribution(engine); bus.size() < length;) {
+            const size_t stop = bus.back();
+            const size_t row = stop / side, column = stop % side;
+            size_t next = stop;
+            switch (direction_distribution(engine)) {
+                case 0: next = column + 1 < side ? stop + 1 : stop; break;
+                case 1: next = column > 0 ? stop - 1 : stop; break;
+                case 2: next = stop + side < stop_count ? stop + side : stop; break;
+                default: next = row > 0 ? stop - side : stop; break;
+            }
+            if (next != stop) {
+                const double distance = geo::ComputeDistance(coordinates[stop], coordinates[next]);
+                road_distances[stop].emplace(next, static_cast<int>(distance * 1.3) + 1);
+                bus.push_back(next);
+            }
+        }
+    }
+
+    std::ostringstream requests;
+    requests << std::setprecision(10) << "{\"base_requests\": ["sv;
+    for (size_t stop = 0; stop < stop_count; ++stop) {
+        requests << (stop > 0 ? ", "sv : ""sv) << "{\"type\": \"Stop\", \"name\": \"S"sv << stop
+                 << "\", \"latitude\": "sv << coordinates[stop].lat << ", \"longitude\": "sv << coordinates[stop].lng
+                 << ", \"road_distances\": {"sv;
+        bool is_first = true;
+        for (const auto& [to, distance] : road_distances[stop]) {
+            requests << (is_first ? ""sv : ", "sv) << "\"S"sv << to << "\": "sv << distance;
+            is_first = false;
+        }
+        requests << "}}"sv;
+    }
+    for (size_t bus = 0; bus < buses.size(); ++bus) {
+        requests << ", {\"type\": \"Bus\", \"name\": \"B"sv << bus << "\", \"is_roundtrip\": false, \"stops\": ["sv;
+        for (size_t idx = 0; idx < buses[bus].size(); ++idx) {
+            requests << (idx > 0 ? ", "sv : ""sv) << "\"S"sv << buses[bus][idx] << '"';
+        }
+        requests << "]}"sv;
+    }
+    requests << "], \"render_settings\": {\"width\": 600, \"height\": 400, \"padding\": 50, \"stop_radius\": 5, "sv
+             << "\"line_width\": 14, \"bus_label_font_size\": 20, \"bus_label_offset\": [7, 15], "sv
+             << "\"stop_label_font_size\": 20, \"stop_label_offset\": [7, -3], "sv
+             << "\"underlayer_color\": [255, 255, 255, 0.85], \"underlayer_width\": 3, "sv
+             << "\"color_palette\": [\"green\", [255, 160, 0], \"red\"]}, "sv
+             << "\"routing_settings\": "sv << routing_settings << ", "sv
+             << "\"serialization_settings\": {\"file\": \""sv << base_file << "\"}}"sv;
+    return requests.str();
+}
+
+// output of process_requests for requests, which go to the reader as they are
+std::string ProcessRequests(const std::string& requests) {
+    std::istringstream input(requests);
+    JsonReader::Reader reader(input);
+    std::ostringstream output;
+    std::streambuf* const cout_buffer = std::cout.rdbuf(output.rdbuf());
+    try {
+        reader.ProcessRequests();
+    } catch (...) {
+        std::cout.rdbuf(cout_buffer);
+        throw;
+    }
+    std::cout.rdbuf(cout_buffer);
+    return output.str();
+}
+
+// Stress of concurrent Route requests: a generated city goes through make_base with router_threads
+// 1, 2, 4... 32, then the same Route requests go through process_requests. Every output must be
+// identical to the single-thread one. Base loading is timed apart and left out of queries per second,
+// both times are the best of three runs.
+int BenchRouteThreads(int argc, char* argv[]) {
+    const size_t stop_count = GetArgument(argc, argv, 2, 4000);
+    const size_t query_count = GetArgument(argc, argv, 3, 2000);
+    const std::string router_type = argc > 4 ? argv[4] : "dijkstra"s;
+    const size_t max_threads = GetArgument(argc, argv, 5, 32);
+    const std::string base_file
+        = (std::filesystem::temp_directory_path() / "transport_catalogue_bench.db"s).string();
+
+    std::mt19937 engine(SEED);
+    std::uniform_int_distribution<size_t> stop_distribution(0, stop_count - 1);
+    std::ostringstream route_requests;
+    for (size_t id = 0; id < query_count; ++id) {
+        route_requests << (id > 0 ? ", "sv : ""sv) << "{\"id\": "sv << id << ", \"type\": \"Route\", \"from\": \"S"sv
+                       << stop_distribution(engine) << "\", \"to\": \"S"sv << stop_distribution(engine) << "\"}"sv;
+    }
+    const std::string serialization_settings = "{\"serialization_settings\": {\"file\": \""s + base_file + "\"}, "s;
+    const std::string load_requests = serialization_settings + "\"stat_requests\": []}"s;
+    const std::string requests = serialization_settings + "\"stat_requests\": ["s + route_requests.str() + "]}"s;
+    std::cout << "route_threads: "sv << stop_count << " stops, "sv << query_count << " routes, "sv
+              << router_type << " router\n"sv;
+
+    std::string serial_output;
+    bool is_identical = true;
+    for (const size_t threads : GetThreadCounts(max_threads)) {
+        std::mt19937 city_engine(SEED);
+        std::istringstream base_requests(GenerateBaseRequests(
+            stop_count,
+            "{\"bus_wait_time\": 6, \"bus_velocity\": 40, \"router\": \""s + router_type
+                + "\", \"router_threads\": "s + std::to_string(threads) + "}"s,
+            base_file, city_engine));
+        JsonReader::Reader(base_requests).MakeBase();
+
+        const double load_seconds = MeasureBestSeconds(3, [&] { ProcessRequests(load_requests); });
+        std::string output;
+        const double seconds = MeasureBestSeconds(3, [&] { output = ProcessRequests(requests); });
+        if (threads == 1) {
+            serial_output = output;
+        }
+        const bool is_same = output == serial_output;
+        is_identical = is_identical && is_same;
+        // replies go to std::cout as well, so its number format is left as it is
+        std::cout << std::setw(4) << threads << " threads: "sv;
+        if (seconds > load_seconds) {
+            std::cout << static_cast<size_t>(query_count / (seconds - load_seconds)) << " queries/s"sv;
+        } else {
+            std::cout << "routes take less than the load noise"sv;
+        }
+        std::cout << ", base loads in "sv << static_cast<size_t>(load_seconds * 1000) << " ms"sv
+                  << (is_same ? ""sv : ", OUTPUT DIFFERS"sv) << '\n';
+    }
+    std::remove(base_file.c_str());
+    return is_identical ? 0 : 1;
+}
+
+// k nearest stops and stops within a radius by a linear scan with geo::ComputeDistance, ordered
+// as StopIndex orders them
+std::vector<Catalogue::StopIndex::StopDistance> ScanStops(const std::deque<domain::Stop>& stops, geo::Coordinates point,
+                                                         size_t count, double radius) {
+    std::vector<Catalogue::StopIndex::StopDistance> found;
+    found.reserve(stops.size());
+    for (const auto& stop : stops) {
+        const double distance = geo::ComputeDistance(point, stop.coordinates);
+        if (distance <= radius) {
+            found.emplace_back(&stop, distance);
+        }
+    }
+    const auto by_distance = [](const auto& lhs, const auto& rhs) {
+        return std::make_pair(lhs.second, lhs.first->id) < std::make_pair(rhs.second, rhs.first->id);
+    };
+    const size_t kept = std::min(count, found.size());
+    std::partial_sort(found.begin(), found.begin() + kept, found.end(), by_distance);
+    found.resize(kept);
+    return found;
+}
+
+// The index and the scan take distances from the chord and from acos, which differ by about
+// a millimeter, so the stops must be the same and the distances only close
+bool IsSameStops(const std::vector<Catalogue::StopIndex::StopDistance>& found,
+                 const std::vector<Catalogue::StopIndex::StopDistance>& expected) {
+    if (found.size() != expected.size()) {
+        return false;
+    }
+    std::vector<uint32_t> found_ids, expected_ids;
+    for (size_t idx = 0; idx < found.size(); ++idx) {
+        if (std::abs(found[idx].second - expected[idx].second) > 0.01) {
+            return false;
+        }
+        found_ids.push_back(found[idx].first->id);
+        expected_ids.push_back(expected[idx].first->id);
+    }
+    std::sort(found_ids.begin(), found_ids.end());
+    std::sort(expected_ids.begin(), expected_ids.end());
+    return found_ids == expected_ids;
+}
+
+// StopIndex against a linear scan on random stops over about 40 x 40 km, a tenth of them sharing
+// the coordinates of another stop, so equally distant stops are common. Half of the queries are
+// at stops. Both must return the same stops.
+int BenchStopIndex(int argc, char* argv[]) {
+    const size_t stop_count = std::max<size_t>(GetArgument(argc, argv, 2, 100000), 1);
+    const size_t query_count = GetArgument(argc, argv, 3, 200);
+    const size_t count = GetArgument(argc, argv, 4, 10);
+    const double radius = static_cast<double>(GetArgument(argc, argv, 5, 500));
+
+    std::mt19937 engine(SEED);
+    std::uniform_real_distribution<double> lat_distribution(55.5, 55.86);
+    std::uniform_real_distribution<double> lng_distribution(37.3, 37.94);
+    std::bernoulli_distribution is_copy(0.1);
+    std::deque<domain::Stop> stops;
+    for (uint32_t id = 0; id < stop_count; ++id) {
+        geo::Coordinates coordinates{ lat_distribution(engine), lng_distribution(engine) };
+        if (id > 0 && is_copy(engine)) {
+            coordinates = stops[std::uniform_int_distribution<size_t>(0, id - 1)(engine)].coordinates;
+        }
+        stops.emplace_back(id, "S"s + std::to_string(id), coordinates.lat, coordinates.lng);
+    }
+    std::vector<geo::Coordinates> points(query_count);
+    std::uniform_int_distribution<size_t> stop_distribution(0, stop_count - 1);
+    for (size_t query = 0; query < query_count; ++query) {
+        points[query] = query % 2 == 0 ? stops[stop_distribution(engine)].coordinates
+                                       : geo::Coordinates{ lat_distribution(engine), lng_distribution(engine) };
+    }
+
+    std::unique_ptr<Catalogue::StopIndex> index;
+    const double build_seconds = MeasureSeconds([&] { index = std::make_unique<Catalogue::StopIndex>(stops); });
+    using Answers = std::vector<std::vector<Catalogue::StopIndex::StopDistance>>;
+    Answers nearest(query_count), within(query_count), scan_nearest(query_count), scan_within(query_count);
+    const double nearest_seconds = MeasureSeconds([&] {
+        for (size_t query = 0; query < query_count; ++query) {
+            nearest[query] = index->FindNearest(points[query], count);
+        }
+    });
+    const double within_seconds = MeasureSeconds([&] {
+        for (size_t query = 0; query < query_count; ++query) {
+            within[query] = index->FindWithin(points[query], radius);
+        }
+    });
+    const double scan_nearest_seconds = MeasureSeconds([&] {
+        for (size_t query = 0; query < query_count; ++query) {
+            scan_nearest[query] = ScanStops(stops, points[query], count, std::numeric_limits<double>::infinity());
+        }
+    });
+    const double scan_within_seconds = MeasureSeconds([&] {
+        for (size_t query = 0; query < query_count; ++query) {
+            scan_within[query] = ScanStops(stops, points[query], stops.size(), radius);
+        }
+    });
+
+    size_t nearest_mismatches = 0, within_mismatches = 0, within_found = 0;
+    for (size_t query = 0; query < query_count; ++query) {
+        nearest_mismatches += IsSameStops(nearest[query], scan_nearest[query]) ? 0 : 1;
+        within_mismatches += IsSameStops(within[query], scan_within[query]) ? 0 : 1;
+        within_found += within[query].size();
+    }
+
+    const double per_query = 1e6 / std::max<size_t>(query_count, 1);
+    std::cout << "stop_index: "sv << stop_count << " stops, "sv << query_count << " queries, build "sv
+              << std::fixed << std::setprecision(1) << build_seconds * 1e3 << " ms\n"sv
+              << "  "sv << count << " nearest: index "sv << nearest_seconds * per_query << " us, scan "sv
+              << scan_nearest_seconds * per_query << " us per query, "sv << nearest_mismatches << " mismatches\n"sv
+              << "  within "sv << radius << " m ("sv << static_cast<double>(within_found) / std::max<size_t>(query_count, 1)
+              << " stops): index "sv << within_seconds * per_query << " us, scan "sv << scan_within_seconds * per_query
+              << " us per query, "sv << within_mismatches << " mismatches\n"sv;
+    return nearest_mismatches == 0 && within_mismatches == 0 ? 0 : 1;
+}
+
+void PrintUsage(std::ostream& stream = std::cerr) {
+    stream << "Usage: transport_catalogue_bench SECTION [ARGUMENTS]\n"sv
+           << "  all_pairs [vertex_count=5000] [max_threads=hardware]\n"sv
+           << "  min_plus [vertex_count=2048] [pivot_count=64]\n"sv
+           << "  vertex_order [vertex_count=3000] [query_count=2000]\n"sv
+           << "  route_threads [stop_count=4000] [query_count=2000] [router=dijkstra] [max_threads=32]\n"sv
+           << "  stop_index [stop_count=100000] [query_count=200] [count=10] [radius=500]\n"sv;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    const std::string_view section(argv[1]);
+    if (section == "all_pairs"sv) {
+        return BenchAllPairs(argc, argv);
+    }
+    if (section == "min_plus"sv) {
+        return BenchMinPlus(argc, argv);
+    }
+    if (section == "vertex_order"sv) {
+        return BenchVertexOrder(argc, argv);
+    }
+    if (section == "route_threads"sv) {
+        return BenchRouteThreads(argc, argv);
+    }
+    if (section == "stop_index"sv) {
+        return BenchStopIndex(argc, argv);
+    }
+    PrintUsage();
+    return 1;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "dijkstra_router.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Point-to-point Dijkstra run from both ends at once: forward over outgoing edges of the source side,
+// backward over incoming edges of the target side. The search ends as soon as the two queue minimums
+// together can't beat the best route met so far. The graph must be frozen.
+template <typename Weight>
+class BidirectionalRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using SearchData = DijkstraSearchData<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    explicit BidirectionalRouter(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    static constexpr EdgeId NONE_EDGE = SearchData::NONE_EDGE;
+
+    struct BidirectionalSearchData {
+        SearchData forward;
+        SearchData backward;
+    };
+
+    static BidirectionalSearchData& GetSearchData() {
+        static thread_local BidirectionalSearchData search_data;
+        return search_data;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+};
+
+template <typename Weight>
+BidirectionalRouter<Weight>::BidirectionalRouter(const Graph& graph)
+    : graph_(graph)
+{
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t edge_count = graph.GetEdgeCount();
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename BidirectionalRouter<Weight>::RouteInfo> BidirectionalRouter<Weight>::BuildRoute(VertexId from,
+                                                                                                       VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+
+    auto& [forward, backward] = GetSearchData();
+    forward.Prepare(vertex_count);
+    backward.Prepare(vertex_count);
+    forward.Reach(from, ZERO_WEIGHT, NONE_EDGE);
+    backward.Reach(to, ZERO_WEIGHT, NONE_EDGE);
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    if (from == to) {
+        best_weight = ZERO_WEIGHT;
+    }
+
+    // every improvement of a vertex reached from both sides is a candidate route,
+    // so the best one always equals the current weights of the meeting vertex
+    const auto meet = [&](VertexId vertex) {
+        if (forward.IsReached(vertex) && backward.IsReached(vertex)) {
+            const Weight route_weight = forward.weights[vertex] + backward.weights[vertex];
+            if (!best_weight || route_weight < *best_weight) {
+                best_weight = route_weight;
+                meeting_vertex = vertex;
+            }
+        }
+    };
+
+    while (!forward.IsQueueEmpty() && !backward.IsQueueEmpty()) {
+        if (best_weight && !(forward.Top().weight + backward.Top().weight < *best_weight)) {
+            break;
+        }
+
+        const bool is_forward = !(backward.Top().weight < forward.Top().weight);
+        SearchData& search = is_forward ? forward : backward;
+        const auto [weight, vertex] = search.Pop();
+        if (search.weights[vertex] < weight) {
+            continue; // outdated queue item
+        }
+        const auto arcs = is_forward ? graph_.GetOutgoingArcs(vertex) : graph_.GetIncomingArcs(vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = weight + arcs.weights[idx];
+            if (!search.IsReached(next) || candidate_weight < search.weights[next]) {
+                search.Reach(next, candidate_weight, arcs.edge_ids[idx]);
+                meet(next);
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = forward.prev_edges[meeting_vertex]; edge_id != NONE_EDGE;
+         edge_id = forward.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    for (EdgeId edge_id = backward.prev_edges[meeting_vertex]; edge_id != NONE_EDGE;
+         edge_id = backward.prev_edges[graph_.GetEdge(edge_id).to])
+    {
+        edges.push_back(edge_id);
+    }
+
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+}  // namespace graph
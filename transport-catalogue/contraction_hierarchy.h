@@ -0,0 +1,493 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "dijkstra_router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Node order and shortcuts of a contraction hierarchy over DirectedWeightedGraph.
+// Edge ids below graph.GetEdgeCount() are the graph's own edges, shortcut i has id GetEdgeCount() + i
+// and stands for the pair of (possibly shortcut) edges it was made of.
+template <typename Weight>
+struct ContractionHierarchy {
+    struct Shortcut {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId first_edge;
+        EdgeId second_edge;
+    };
+
+    std::vector<size_t> vertex_rank;
+    std::vector<Shortcut> shortcuts;
+
+    bool IsEmpty() const {
+        return vertex_rank.empty();
+    }
+};
+
+template <typename Weight>
+class ContractionHierarchyBuilder {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit ContractionHierarchyBuilder(const Graph& graph);
+
+    ContractionHierarchy<Weight> Build();
+
+private:
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge_id;
+    };
+
+    struct Candidate {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId first_edge;
+        EdgeId second_edge;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    // witness searches give up after settling this many vertices and keep the shortcut,
+    // estimating a priority may afford a rougher search than the contraction itself
+    static constexpr size_t PRIORITY_SETTLE_LIMIT = 50;
+    static constexpr size_t CONTRACTION_SETTLE_LIMIT = 500;
+
+    void AddArc(VertexId from, VertexId to, Weight weight, EdgeId edge_id);
+    void FindShortcuts(VertexId vertex, size_t settle_limit);
+    void RunWitnessSearch(VertexId source, VertexId excluded, Weight max_weight,
+                          size_t target_count, size_t settle_limit);
+    int GetPriority(VertexId vertex);
+    void Contract(VertexId vertex);
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    ContractionHierarchy<Weight> hierarchy_;
+
+    std::vector<std::vector<Arc>> out_arcs_;
+    std::vector<std::vector<Arc>> in_arcs_;
+    std::vector<bool> contracted_;
+    std::vector<int> contracted_neighbours_;
+
+    std::vector<Weight> witness_weights_;
+    std::vector<uint32_t> witness_stamps_;
+    std::vector<uint32_t> target_stamps_;
+    std::vector<Weight> target_weights_;
+    uint32_t witness_stamp_ = 0;
+    std::vector<QueueItem> witness_queue_;
+    std::vector<Candidate> candidates_;
+};
+
+template <typename Weight>
+ContractionHierarchyBuilder<Weight>::ContractionHierarchyBuilder(const Graph& graph)
+    : graph_(graph)
+    , out_arcs_(graph.GetVertexCount())
+    , in_arcs_(graph.GetVertexCount())
+    , contracted_(graph.GetVertexCount(), false)
+    , contracted_neighbours_(graph.GetVertexCount(), 0)
+    , witness_weights_(graph.GetVertexCount())
+    , witness_stamps_(graph.GetVertexCount(), 0)
+    , target_stamps_(graph.GetVertexCount(), 0)
+    , target_weights_(graph.GetVertexCount())
+{
+    const size_t edge_count = graph.GetEdgeCount();
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (edge.from != edge.to) {
+            AddArc(edge.from, edge.to, edge.weight, edge_id);
+        }
+    }
+}
+
+// keeps a single, lightest arc for every pair of vertices
+template <typename Weight>
+void ContractionHierarchyBuilder<Weight>::AddArc(VertexId from, VertexId to, Weight weight, EdgeId edge_id) {
+    auto& out_arcs = out_arcs_[from];
+    const auto out_it = std::find_if(out_arcs.begin(), out_arcs.end(),
+                                     [to](const Arc& arc) { return arc.vertex == to; });
+    if (out_it == out_arcs.end()) {
+        out_arcs.push_back({to, weight, edge_id});
+        in_arcs_[to].push_back({from, weight, edge_id});
+        return;
+    }
+    if (!(weight < out_it->weight)) {
+        return;
+    }
+    *out_it = {to, weight, edge_id};
+    auto& in_arcs = in_arcs_[to];
+    *std::find_if(in_arcs.begin(), in_arcs.end(),
+                  [from](const Arc& arc) { return arc.vertex == from; }) = {from, weight, edge_id};
+}
+
+// a target is witnessed once some path avoiding the contracted vertex is not longer than the shortcut,
+// the search stops as soon as all targets are witnessed
+template <typename Weight>
+void ContractionHierarchyBuilder<Weight>::RunWitnessSearch(VertexId source, VertexId excluded, Weight max_weight,
+                                                           size_t target_count, size_t settle_limit) {
+    witness_queue_.clear();
+    const auto reach = [this, &target_count](VertexId vertex, Weight weight) {
+        witness_stamps_[vertex] = witness_stamp_;
+        witness_weights_[vertex] = weight;
+        witness_queue_.push_back({weight, vertex});
+        std::push_heap(witness_queue_.begin(), witness_queue_.end(), std::greater<QueueItem>{});
+        if (target_stamps_[vertex] == witness_stamp_ && !(target_weights_[vertex] < weight)) {
+            target_stamps_[vertex] = 0;
+            --target_count;
+        }
+    };
+    reach(source, ZERO_WEIGHT);
+
+    size_t settled = 0;
+    while (!witness_queue_.empty() && settled < settle_limit && target_count > 0) {
+        std::pop_heap(witness_queue_.begin(), witness_queue_.end(), std::greater<QueueItem>{});
+        const auto [weight, vertex] = witness_queue_.back();
+        witness_queue_.pop_back();
+        if (witness_weights_[vertex] < weight) {
+            continue;
+        }
+        if (max_weight < weight) {
+            break;
+        }
+        ++settled;
+        for (const Arc& arc : out_arcs_[vertex]) {
+            if (contracted_[arc.vertex] || arc.vertex == excluded) {
+                continue;
+            }
+            const Weight candidate_weight = weight + arc.weight;
+            if (witness_stamps_[arc.vertex] != witness_stamp_ || candidate_weight < witness_weights_[arc.vertex]) {
+                reach(arc.vertex, candidate_weight);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchyBuilder<Weight>::FindShortcuts(VertexId vertex, size_t settle_limit) {
+    candidates_.clear();
+    for (const Arc& in_arc : in_arcs_[vertex]) {
+        if (contracted_[in_arc.vertex]) {
+            continue;
+        }
+        if (++witness_stamp_ == 0) {
+            std::fill(witness_stamps_.begin(), witness_stamps_.end(), 0);
+            std::fill(target_stamps_.begin(), target_stamps_.end(), 0);
+            witness_stamp_ = 1;
+        }
+        Weight max_weight = ZERO_WEIGHT;
+        size_t target_count = 0;
+        for (const Arc& out_arc : out_arcs_[vertex]) {
+            if (!contracted_[out_arc.vertex] && out_arc.vertex != in_arc.vertex) {
+                max_weight = std::max(max_weight, in_arc.weight + out_arc.weight);
+                target_stamps_[out_arc.vertex] = witness_stamp_;
+                target_weights_[out_arc.vertex] = in_arc.weight + out_arc.weight;
+                ++target_count;
+            }
+        }
+        if (target_count == 0) {
+            continue;
+        }
+
+        RunWitnessSearch(in_arc.vertex, vertex, max_weight, target_count, settle_limit);
+        for (const Arc& out_arc : out_arcs_[vertex]) {
+            // targets left stamped have no witness
+            if (target_stamps_[out_arc.vertex] == witness_stamp_) {
+                candidates_.push_back({in_arc.vertex, out_arc.vertex, in_arc.weight + out_arc.weight,
+                                       in_arc.edge_id, out_arc.edge_id});
+            }
+        }
+    }
+}
+
+// edge difference plus the number of already contracted neighbours, which spreads contraction evenly
+template <typename Weight>
+int ContractionHierarchyBuilder<Weight>::GetPriority(VertexId vertex) {
+    FindShortcuts(vertex, PRIORITY_SETTLE_LIMIT);
+    int removed_arcs = 0;
+    for (const Arc& arc : in_arcs_[vertex]) {
+        removed_arcs += contracted_[arc.vertex] ? 0 : 1;
+    }
+    for (const Arc& arc : out_arcs_[vertex]) {
+        removed_arcs += contracted_[arc.vertex] ? 0 : 1;
+    }
+    return static_cast<int>(candidates_.size()) - removed_arcs + contracted_neighbours_[vertex];
+}
+
+template <typename Weight>
+void ContractionHierarchyBuilder<Weight>::Contract(VertexId vertex) {
+    FindShortcuts(vertex, CONTRACTION_SETTLE_LIMIT);
+    const EdgeId first_shortcut_id = graph_.GetEdgeCount();
+    for (const Candidate& candidate : candidates_) {
+        const EdgeId shortcut_id = first_shortcut_id + hierarchy_.shortcuts.size();
+        hierarchy_.shortcuts.push_back({candidate.from, candidate.to, candidate.weight,
+                                        candidate.first_edge, candidate.second_edge});
+        AddArc(candidate.from, candidate.to, candidate.weight, shortcut_id);
+    }
+
+    contracted_[vertex] = true;
+    for (const Arc& arc : in_arcs_[vertex]) {
+        ++contracted_neighbours_[arc.vertex];
+    }
+    for (const Arc& arc : out_arcs_[vertex]) {
+        ++contracted_neighbours_[arc.vertex];
+    }
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight> ContractionHierarchyBuilder<Weight>::Build() {
+    const size_t vertex_count = graph_.GetVertexCount();
+    hierarchy_.vertex_rank.assign(vertex_count, 0);
+    hierarchy_.shortcuts.clear();
+
+    using PriorityItem = std::pair<int, VertexId>;
+    std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> queue;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.push({GetPriority(vertex), vertex});
+    }
+
+    size_t rank = 0;
+    while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+
+        // lazy update: priorities of the remaining vertices may have grown since they were queued
+        const int priority = GetPriority(vertex);
+        if (!queue.empty() && priority > queue.top().first) {
+            queue.push({priority, vertex});
+            continue;
+        }
+        Contract(vertex);
+        hierarchy_.vertex_rank[vertex] = rank++;
+    }
+
+    out_arcs_.clear();
+    in_arcs_.clear();
+    return std::move(hierarchy_);
+}
+
+// Bidirectional Dijkstra over the upward arcs of a contraction hierarchy, shortcuts are unpacked
+// back into the graph's own edges, so routes look the same as from any other engine.
+template <typename Weight>
+class ContractionHierarchyRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using SearchData = DijkstraSearchData<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    ContractionHierarchyRouter(const Graph& graph, ContractionHierarchy<Weight> hierarchy);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    static constexpr EdgeId NONE_EDGE = SearchData::NONE_EDGE;
+
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge_id;
+    };
+
+    // arcs leading to higher ranked vertices, stored contiguously per vertex
+    struct UpwardArcs {
+        std::vector<size_t> offsets;
+        std::vector<Arc> arcs;
+
+        ranges::Range<typename std::vector<Arc>::const_iterator> GetArcs(VertexId vertex) const {
+            return {arcs.begin() + offsets[vertex], arcs.begin() + offsets[vertex + 1]};
+        }
+    };
+
+    struct BidirectionalSearchData {
+        SearchData forward;
+        SearchData backward;
+    };
+
+    static BidirectionalSearchData& GetSearchData() {
+        static thread_local BidirectionalSearchData search_data;
+        return search_data;
+    }
+
+    VertexId GetEdgeFrom(EdgeId edge_id) const;
+    VertexId GetEdgeTo(EdgeId edge_id) const;
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    ContractionHierarchy<Weight> hierarchy_;
+    UpwardArcs forward_arcs_;
+    UpwardArcs backward_arcs_;
+};
+
+template <typename Weight>
+ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph,
+                                                               ContractionHierarchy<Weight> hierarchy)
+    : graph_(graph)
+    , hierarchy_(std::move(hierarchy))
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t edge_count = graph.GetEdgeCount();
+    if (hierarchy_.vertex_rank.size() != vertex_count) {
+        throw std::invalid_argument("Contraction hierarchy doesn't match the graph");
+    }
+    const auto& rank = hierarchy_.vertex_rank;
+
+    // forward arcs are kept at their tail, backward arcs at their head and point to the tail
+    std::vector<std::pair<VertexId, Arc>> forward;
+    std::vector<std::pair<VertexId, Arc>> backward;
+    const auto add_arc = [&](VertexId from, VertexId to, Weight weight, EdgeId edge_id) {
+        if (rank[from] < rank[to]) {
+            forward.push_back({from, Arc{to, weight, edge_id}});
+        } else if (rank[to] < rank[from]) {
+            backward.push_back({to, Arc{from, weight, edge_id}});
+        }
+    };
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        add_arc(edge.from, edge.to, edge.weight, edge_id);
+    }
+    for (size_t idx = 0; idx < hierarchy_.shortcuts.size(); ++idx) {
+        const auto& shortcut = hierarchy_.shortcuts[idx];
+        add_arc(shortcut.from, shortcut.to, shortcut.weight, edge_count + idx);
+    }
+
+    const auto fill_arcs = [vertex_count](std::vector<std::pair<VertexId, Arc>>& arcs, UpwardArcs& upward_arcs) {
+        std::stable_sort(arcs.begin(), arcs.end(),
+                         [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        upward_arcs.offsets.assign(vertex_count + 1, 0);
+        upward_arcs.arcs.reserve(arcs.size());
+        for (const auto& [vertex, arc] : arcs) {
+            ++upward_arcs.offsets[vertex + 1];
+            upward_arcs.arcs.push_back(arc);
+        }
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            upward_arcs.offsets[vertex + 1] += upward_arcs.offsets[vertex];
+        }
+    };
+    fill_arcs(forward, forward_arcs_);
+    fill_arcs(backward, backward_arcs_);
+}
+
+template <typename Weight>
+VertexId ContractionHierarchyRouter<Weight>::GetEdgeFrom(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    return edge_id < edge_count ? graph_.GetEdge(edge_id).from : hierarchy_.shortcuts[edge_id - edge_count].from;
+}
+
+template <typename Weight>
+VertexId ContractionHierarchyRouter<Weight>::GetEdgeTo(EdgeId edge_id) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    return edge_id < edge_count ? graph_.GetEdge(edge_id).to : hierarchy_.shortcuts[edge_id - edge_count].to;
+}
+
+template <typename Weight>
+void ContractionHierarchyRouter<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    const size_t edge_count = graph_.GetEdgeCount();
+    std::vector<EdgeId> stack{edge_id};
+    while (!stack.empty()) {
+        const EdgeId current = stack.back();
+        stack.pop_back();
+        if (current < edge_count) {
+            edges.push_back(current);
+            continue;
+        }
+        const auto& shortcut = hierarchy_.shortcuts[current - edge_count];
+        stack.push_back(shortcut.second_edge);
+        stack.push_back(shortcut.first_edge);
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo>
+ContractionHierarchyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+
+    auto& [forward, backward] = GetSearchData();
+    forward.Prepare(vertex_count);
+    backward.Prepare(vertex_count);
+    forward.Reach(from, ZERO_WEIGHT, NONE_EDGE);
+    backward.Reach(to, ZERO_WEIGHT, NONE_EDGE);
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    const auto step = [&](SearchData& search, const SearchData& other, const UpwardArcs& upward_arcs) {
+        const auto [weight, vertex] = search.Pop();
+        if (search.weights[vertex] < weight) {
+            return;
+        }
+        if (other.IsReached(vertex)) {
+            const Weight route_weight = weight + other.weights[vertex];
+            if (!best_weight || route_weight < *best_weight) {
+                best_weight = route_weight;
+                meeting_vertex = vertex;
+            }
+        }
+        for (const Arc& arc : upward_arcs.GetArcs(vertex)) {
+            const Weight candidate_weight = weight + arc.weight;
+            if (!search.IsReached(arc.vertex) || candidate_weight < search.weights[arc.vertex]) {
+                search.Reach(arc.vertex, candidate_weight, arc.edge_id);
+            }
+        }
+    };
+
+    // a direction is finished once its queue can't improve the best meeting found so far
+    const auto is_active = [&best_weight](SearchData& search) {
+        return !search.IsQueueEmpty() && (!best_weight || search.Top().weight < *best_weight);
+    };
+    while (is_active(forward) || is_active(backward)) {
+        if (is_active(forward)
+            && (!is_active(backward) || !(backward.Top().weight < forward.Top().weight))) {
+            step(forward, backward, forward_arcs_);
+        } else {
+            step(backward, forward, backward_arcs_);
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> upward_edges;
+    for (EdgeId edge_id = forward.prev_edges[meeting_vertex]; edge_id != NONE_EDGE;
+         edge_id = forward.prev_edges[GetEdgeFrom(edge_id)])
+    {
+        upward_edges.push_back(edge_id);
+    }
+    std::reverse(upward_edges.begin(), upward_edges.end());
+    for (EdgeId edge_id = backward.prev_edges[meeting_vertex]; edge_id != NONE_EDGE;
+         edge_id = backward.prev_edges[GetEdgeTo(edge_id)])
+    {
+        upward_edges.push_back(edge_id);
+    }
+
+    std::vector<EdgeId> edges;
+    for (const EdgeId edge_id : upward_edges) {
+        UnpackEdge(edge_id, edges);
+    }
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "radix_heap.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Dijkstra state which is reused between searches, so a query allocates nothing once the buffers
+// have grown to the graph size: a vertex's weight and prev_edge are valid only when its stamp
+// equals the stamp of the current search. The queue is a binary heap, or a radix heap for unsigned
+// integer weights.
+template <typename Weight>
+struct DijkstraSearchData {
+    static constexpr EdgeId NONE_EDGE = std::numeric_limits<EdgeId>::max();
+
+    struct QueueItem {
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return weight > other.weight;
+        }
+    };
+
+    using Queue = std::conditional_t<std::is_unsigned_v<Weight>, RadixHeap<Weight, VertexId>, std::vector<QueueItem>>;
+
+    std::vector<Weight> weights;
+    std::vector<EdgeId> prev_edges;
+    std::vector<uint32_t> stamps;
+    Queue queue;
+    uint32_t stamp = 0;
+
+    void Prepare(size_t vertex_count) {
+        if (stamps.size() < vertex_count) {
+            weights.resize(vertex_count);
+            prev_edges.resize(vertex_count);
+            stamps.resize(vertex_count, 0);
+        }
+        if constexpr (std::is_unsigned_v<Weight>) {
+            queue.Clear();
+        } else {
+            queue.clear();
+        }
+        if (++stamp == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            stamp = 1;
+        }
+    }
+
+    bool IsReached(VertexId vertex) const {
+        return stamps[vertex] == stamp;
+    }
+
+    void Reach(VertexId vertex, Weight weight, EdgeId prev_edge) {
+        stamps[vertex] = stamp;
+        weights[vertex] = weight;
+        prev_edges[vertex] = prev_edge;
+        if constexpr (std::is_unsigned_v<Weight>) {
+            queue.Push(weight, vertex);
+        } else {
+            queue.push_back({weight, vertex});
+            std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+        }
+    }
+
+    bool IsQueueEmpty() const {
+        if constexpr (std::is_unsigned_v<Weight>) {
+            return queue.IsEmpty();
+        } else {
+            return queue.empty();
+        }
+    }
+
+    QueueItem Top() {
+        if constexpr (std::is_unsigned_v<Weight>) {
+            const auto& [weight, vertex] = queue.Top();
+            return {weight, vertex};
+        } else {
+            return queue.front();
+        }
+    }
+
+    QueueItem Pop() {
+        if constexpr (std::is_unsigned_v<Weight>) {
+            const auto [weight, vertex] = queue.Pop();
+            return {weight, vertex};
+        } else {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            const QueueItem item = queue.back();
+            queue.pop_back();
+            return item;
+        }
+    }
+};
+
+// Answers every query with a single-source Dijkstra which stops as soon as the target is settled.
+// Nothing is precomputed: startup is one pass over the edges, memory is the graph itself.
+// The graph must be frozen.
+template <typename Weight>
+class DijkstraRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using SearchData = DijkstraSearchData<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    explicit DijkstraRouter(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    static constexpr EdgeId NONE_EDGE = SearchData::NONE_EDGE;
+
+    static SearchData& GetSearchData() {
+        static thread_local SearchData search_data;
+        return search_data;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+    : graph_(graph)
+{
+    if (!graph.IsFrozen()) {
+        throw std::invalid_argument("Graph should be frozen");
+    }
+    const size_t edge_count = graph.GetEdgeCount();
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+
+    SearchData& data = GetSearchData();
+    data.Prepare(vertex_count);
+    data.Reach(from, ZERO_WEIGHT, NONE_EDGE);
+
+    while (!data.IsQueueEmpty()) {
+        const auto [weight, vertex] = data.Pop();
+        if (data.weights[vertex] < weight) {
+            continue; // outdated queue item
+        }
+        if (vertex == to) {
+            break;
+        }
+        const auto arcs = graph_.GetOutgoingArcs(vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = weight + arcs.weights[idx];
+            if (!data.IsReached(next) || candidate_weight < data.weights[next]) {
+                data.Reach(next, candidate_weight, arcs.edge_ids[idx]);
+            }
+        }
+    }
+
+    if (!data.IsReached(to)) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = data.prev_edges[to]; edge_id != NONE_EDGE;
+         edge_id = data.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{data.weights[to], std::move(edges)};
+}
+
+// Best route from any of the sources to any of the targets: a route from a source starts with the weight
+// of the source, a route to a target ends with the weight of the target added. One Dijkstra is seeded by
+// all the sources and stops when no queued vertex can beat the best target reached, so the graph is only
+// read and concurrent searches may share it. The graph must be frozen.
+template <typename Weight>
+struct MultiRouteInfo {
+    Weight weight;
+    std::vector<EdgeId> edges;
+    VertexId from; // the source the route starts at
+    VertexId to; // the target it ends at
+};
+
+template <typename Weight>
+std::optional<MultiRouteInfo<Weight>> BuildMultiRoute(const DirectedWeightedGraph<Weight>& graph,
+                                                      const std::vector<std::pair<VertexId, Weight>>& sources,
+                                                      std::vector<std::pair<VertexId, Weight>> targets) {
+    using SearchData = DijkstraSearchData<Weight>;
+    static constexpr EdgeId NONE_EDGE = SearchData::NONE_EDGE;
+
+    const size_t vertex_count = graph.GetVertexCount();
+    for (const auto& [vertex, weight] : sources) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of graph");
+        }
+    }
+    // targets are looked up by vertex, the lightest of the ones at the same vertex is kept
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first == rhs.first;
+    }), targets.end());
+
+    static thread_local SearchData data;
+    data.Prepare(vertex_count);
+    for (const auto& [vertex, weight] : sources) {
+        if (!data.IsReached(vertex) || weight < data.weights[vertex]) {
+            data.Reach(vertex, weight, NONE_EDGE);
+        }
+    }
+
+    std::optional<Weight> best_weight;
+    VertexId best_target = 0;
+    while (!data.IsQueueEmpty()) {
+        const auto [weight, vertex] = data.Pop();
+        if (data.weights[vertex] < weight) {
+            continue; // outdated queue item
+        }
+        if (best_weight && !(weight < *best_weight)) {
+            break;
+        }
+        const auto target = std::lower_bound(targets.begin(), targets.end(), std::make_pair(vertex, Weight{}),
+                                             [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        if (target != targets.end() && target->first == vertex) {
+            if (const Weight route_weight = weight + target->second; !best_weight || route_weight < *best_weight) {
+                best_weight = route_weight;
+                best_target = vertex;
+            }
+        }
+        const auto arcs = graph.GetOutgoingArcs(vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = weight + arcs.weights[idx];
+            if (!data.IsReached(next) || candidate_weight < data.weights[next]) {
+                data.Reach(next, candidate_weight, arcs.edge_ids[idx]);
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    VertexId from = best_target;
+    for (EdgeId edge_id = data.prev_edges[best_target]; edge_id != NONE_EDGE; edge_id = data.prev_edges[from]) {
+        edges.push_back(edge_id);
+        from = graph.GetEdge(edge_id).from;
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return MultiRouteInfo<Weight>{*best_weight, std::move(edges), from, best_target};
+}
+
+}  // namespace graph
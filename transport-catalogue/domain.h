@@ -15,19 +15,10 @@
 
 namespace domain {
 
-static uint32_t id_count = 0;
-
 struct Stop {
     uint32_t id = 0;
     std::string name_; // название остановки
     geo::Coordinates coordinates; // координаты остановки
-    explicit Stop(std::string name, double latit, double longt)
-        : id(id_count++)
-        , name_(name)
-        , coordinates({latit, longt})
-    {
-    }
-
     explicit Stop(uint32_t id_, std::string name, double latit, double longt)
         : id(id_)
         , name_(name)
@@ -36,6 +27,10 @@ struct Stop {
     }
 };
 
+// one run of a bus along its route_: departure time from each stop of the route,
+// in minutes from the start of the service day
+using Trip = std::vector<double>;
+
 struct Bus {
     std::string name_; // название маршрута
     std::vector<const Stop*> route_; // маршрут по остановкам
@@ -44,6 +39,8 @@ struct Bus {
     double geo_length_ = 0;
     bool is_roundtrip_;
     const Stop* last_stop_;
+    std::vector<int64_t> route_distances_; // road distance from the first stop to each stop of route_
+    std::vector<Trip> trips_; // timetable in order of departure, empty for buses without one
     explicit Bus(std::string name, const std::vector<const Stop*>& route, size_t size, int64_t length,
         double geo_length, bool is_roundtrip, const Stop* last_stop)
         : name_(name)
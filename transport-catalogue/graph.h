@@ -3,6 +3,7 @@
 #include "ranges.h"
 
 #include <cstdlib>
+#include <stdexcept>
 #include <vector>
 
 namespace graph {
@@ -17,6 +18,10 @@ struct Edge {
     Weight weight;
 };
 
+// Edges are added to per-vertex incidence lists. Freeze moves the lists into compressed sparse
+// row form: per vertex offsets into contiguous arrays of edge ids, far ends and weights. The edge
+// ranges keep working the same way, and search kernels can iterate the arcs linearly without
+// looking edges up by id. A frozen graph takes no more edges.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
@@ -24,36 +29,120 @@ private:
     using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
 
 public:
+    // arcs of one vertex in structure-of-arrays layout: the i-th arc is the edge edge_ids[i]
+    // to (or from, for incoming arcs) vertices[i] of weight weights[i]
+    struct ArcsRange {
+        const EdgeId* edge_ids;
+        const VertexId* vertices;
+        const Weight* weights;
+        size_t size;
+    };
+
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
     EdgeId AddEdge(const Edge<Weight>& edge);
 
+    void Freeze();
+    bool IsFrozen() const;
+
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    // frozen graph only
+    ArcsRange GetOutgoingArcs(VertexId vertex) const;
+    ArcsRange GetIncomingArcs(VertexId vertex) const;
+
 private:
+    struct CompressedLists {
+        std::vector<size_t> offsets; // vertex_count + 1
+        std::vector<EdgeId> edge_ids;
+        std::vector<VertexId> vertices;
+        std::vector<Weight> weights;
+
+        IncidentEdgesRange GetEdges(VertexId vertex) const {
+            return IncidentEdgesRange{edge_ids.begin() + offsets[vertex], edge_ids.begin() + offsets[vertex + 1]};
+        }
+        ArcsRange GetArcs(VertexId vertex) const {
+            const size_t begin = offsets[vertex];
+            return ArcsRange{edge_ids.data() + begin, vertices.data() + begin, weights.data() + begin,
+                             offsets[vertex + 1] - begin};
+        }
+    };
+
+    CompressedLists CompressLists(std::vector<IncidenceList>& lists, bool is_outgoing) const;
+
+    size_t vertex_count_ = 0;
+    bool is_frozen_ = false;
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    std::vector<IncidenceList> incoming_lists_;
+    CompressedLists outgoing_arcs_;
+    CompressedLists incoming_arcs_;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {
+    : vertex_count_(vertex_count)
+    , incidence_lists_(vertex_count)
+    , incoming_lists_(vertex_count) {
 }
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (is_frozen_) {
+        throw std::logic_error("Can't add an edge to a frozen graph");
+    }
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_.at(edge.from).push_back(id);
+    incoming_lists_.at(edge.to).push_back(id);
     return id;
 }
 
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::CompressedLists
+DirectedWeightedGraph<Weight>::CompressLists(std::vector<IncidenceList>& lists, bool is_outgoing) const {
+    CompressedLists compressed;
+    compressed.offsets.reserve(vertex_count_ + 1);
+    compressed.edge_ids.reserve(edges_.size());
+    compressed.vertices.reserve(edges_.size());
+    compressed.weights.reserve(edges_.size());
+    compressed.offsets.push_back(0);
+    for (auto& list : lists) {
+        for (const EdgeId edge_id : list) {
+            const Edge<Weight>& edge = edges_[edge_id];
+            compressed.edge_ids.push_back(edge_id);
+            compressed.vertices.push_back(is_outgoing ? edge.to : edge.from);
+            compressed.weights.push_back(edge.weight);
+        }
+        compressed.offsets.push_back(compressed.edge_ids.size());
+        IncidenceList{}.swap(list);
+    }
+    return compressed;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+    if (is_frozen_) {
+        return;
+    }
+    outgoing_arcs_ = CompressLists(incidence_lists_, true);
+    incoming_arcs_ = CompressLists(incoming_lists_, false);
+    std::vector<IncidenceList>{}.swap(incidence_lists_);
+    std::vector<IncidenceList>{}.swap(incoming_lists_);
+    is_frozen_ = true;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return is_frozen_;
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
 }
 
 template <typename Weight>
@@ -69,7 +158,28 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+    if (is_frozen_) {
+        return outgoing_arcs_.GetEdges(vertex);
+    }
     return ranges::AsRange(incidence_lists_.at(vertex));
 }
 
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::ArcsRange
+DirectedWeightedGraph<Weight>::GetOutgoingArcs(VertexId vertex) const {
+    if (!is_frozen_) {
+        throw std::logic_error("Arcs are available in a frozen graph only");
+    }
+    return outgoing_arcs_.GetArcs(vertex);
+}
+
+template <typename Weight>
+typename DirectedWeightedGraph<Weight>::ArcsRange
+DirectedWeightedGraph<Weight>::GetIncomingArcs(VertexId vertex) const {
+    if (!is_frozen_) {
+        throw std::logic_error("Arcs are available in a frozen graph only");
+    }
+    return incoming_arcs_.GetArcs(vertex);
+}
+
 }  // namespace graph
\ No newline at end of file
@@ -5,14 +5,221 @@
 #include "transport_catalogue.h"
 #include "transport_router.h"
 #include "serialization.h"
+#include "parallel.h"
+#include "log_duration.h"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
 
 #include <fstream>
+#include <iostream>
 #include <filesystem>
 
 namespace JsonReader {
 
+namespace {
+
+// bus velocity in km/h to meters per minute
+constexpr double CONVERSION = 1'000. / 60;
+
+// an end of a Route request is a stop name or a point {"latitude", "longitude"}
+std::optional<geo::Coordinates> AsRoutePoint(const Node& node) {
+    if (!node.IsDict()) {
+        return std::nullopt;
+    }
+    return geo::Coordinates{ node.AsDict().at("latitude"s).AsDouble(), node.AsDict().at("longitude"s).AsDouble() };
+}
+
+// edges of buses with their bus and span count, in the order they go to the graph
+struct BusEdges {
+    std::vector<Edge<double>> edges;
+    Edge_BusSpan bus_spans;
+};
+
+// Calls make_bus_edges(bus_index, bus_edges) for every bus on thread_count threads, each taking a contiguous
+// range of buses with about the same number of edges, then merges the edges in bus order,
+// so edge ids are the same for any thread count
+template <typename MakeBusEdges>
+BusEdges CollectBusEdges(const std::vector<size_t>& bus_edge_counts, size_t thread_count, MakeBusEdges make_bus_edges) {
+    const size_t bus_count = bus_edge_counts.size();
+    std::vector<size_t> edge_offsets(bus_count + 1, 0);
+    std::partial_sum(bus_edge_counts.begin(), bus_edge_counts.end(), edge_offsets.begin() + 1);
+    const size_t edge_count = edge_offsets.back();
+    thread_count = std::min(parallel::GetThreadCount(thread_count), std::max<size_t>(bus_count, 1));
+
+    // a bus goes to the thread whose share of edges holds its first edge
+    std::vector<BusEdges> thread_edges(thread_count);
+    parallel::ForEachThread(thread_count, [&](size_t thread_index) {
+        const auto [edges_begin, edges_end] = parallel::GetThreadShare(edge_count, thread_index, thread_count);
+        const auto offsets_end = edge_offsets.begin() + bus_count;
+        const size_t bus_begin = std::lower_bound(edge_offsets.begin(), offsets_end, edges_begin) - edge_offsets.begin();
+        const size_t bus_end = std::lower_bound(edge_offsets.begin(), offsets_end, edges_end) - edge_offsets.begin();
+
+        BusEdges& bus_edges = thread_edges[thread_index];
+        bus_edges.edges.reserve(edge_offsets[bus_end] - edge_offsets[bus_begin]);
+        bus_edges.bus_spans.reserve(edge_offsets[bus_end] - edge_offsets[bus_begin]);
+        for (size_t bus_index = bus_begin; bus_index < bus_end; ++bus_index) {
+            make_bus_edges(bus_index, bus_edges);
+        }
+    });
+
+    BusEdges result = std::move(thread_edges.front());
+    result.edges.reserve(edge_count);
+    result.bus_spans.reserve(edge_count);
+    for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+        const BusEdges& bus_edges = thread_edges[thread_index];
+        result.edges.insert(result.edges.end(), bus_edges.edges.begin(), bus_edges.edges.end());
+        result.bus_spans.insert(result.bus_spans.end(), bus_edges.bus_spans.begin(), bus_edges.bus_spans.end());
+    }
+    return result;
+}
+
+// Of the edges between the same pair of vertices keeps only the lightest one, the first of equally light ones,
+// with its bus and span count; kept edges stay in their order. Returns the number of removed edges
+size_t PruneDominatedEdges(size_t vertex_count, BusEdges& bus_edges) {
+    const auto& edges = bus_edges.edges;
+    const size_t edge_count = edges.size();
+
+    // edges grouped by their from vertex, in edge order within a group
+    std::vector<size_t> from_offsets(vertex_count + 1, 0);
+    for (const auto& edge : edges) {
+        ++from_offsets[edge.from + 1];
+    }
+    std::partial_sum(from_offsets.begin(), from_offsets.end(), from_offsets.begin());
+    std::vector<size_t> grouped_edges(edge_count);
+    {
+        std::vector<size_t> positions(from_offsets.begin(), from_offsets.end() - 1);
+        for (size_t edge_id = 0; edge_id < edge_count; ++edge_id) {
+            grouped_edges[positions[edges[edge_id].from]++] = edge_id;
+        }
+    }
+
+    // within a group the lightest edge to a vertex is valid while its stamp is from + 1
+    std::vector<size_t> lightest_edges(vertex_count);
+    std::vector<size_t> stamps(vertex_count, 0);
+    std::vector<bool> is_kept(edge_count, true);
+    for (size_t from = 0; from < vertex_count; ++from) {
+        for (size_t idx = from_offsets[from]; idx < from_offsets[from + 1]; ++idx) {
+            const size_t edge_id = grouped_edges[idx];
+            const size_t to = edges[edge_id].to;
+            if (stamps[to] != from + 1) {
+                stamps[to] = from + 1;
+                lightest_edges[to] = edge_id;
+            } else if (edges[edge_id].weight < edges[lightest_edges[to]].weight) {
+                is_kept[lightest_edges[to]] = false;
+                lightest_edges[to] = edge_id;
+            } else {
+                is_kept[edge_id] = false;
+            }
+        }
+    }
+
+    size_t kept_count = 0;
+    for (size_t edge_id = 0; edge_id < edge_count; ++edge_id) {
+        if (is_kept[edge_id]) {
+            bus_edges.edges[kept_count] = bus_edges.edges[edge_id];
+            bus_edges.bus_spans[kept_count] = bus_edges.bus_spans[edge_id];
+            ++kept_count;
+        }
+    }
+    bus_edges.edges.resize(kept_count);
+    bus_edges.bus_spans.resize(kept_count);
+    return edge_count - kept_count;
+}
+
+void AddBusEdges(DirectedWeightedGraph<double>& graph_, Edge_BusSpan& edge_to_bus_span, const BusEdges& bus_edges) {
+    for (const auto& edge : bus_edges.edges) {
+        graph_.AddEdge(edge);
+    }
+    edge_to_bus_span.insert(edge_to_bus_span.end(), bus_edges.bus_spans.begin(), bus_edges.bus_spans.end());
+}
+
+// Walking edges both ways between every two stops on buses no farther than transfer_radius_ apart, walked
+// at walk_velocity_, with a nullptr bus. The stops are joined through a k-d tree, each one asking for its
+// neighbours, on router_threads_ threads taking contiguous ranges of stops, so edge ids don't depend
+// on the thread count. The number of edges and the time taken go to the log
+BusEdges CollectWalkEdges(const TransportCatalogue& catalogue, const Stop_VertexId& stop_to_vertex,
+                          const RoutingSettings& routing_settings) {
+    LOG_DURATION("walking transfers built"s);
+    const double radius = routing_settings.transfer_radius_;
+    const double meters_per_minute = routing_settings.walk_velocity_ * CONVERSION;
+
+    const StopIndex stop_index(catalogue.GetStops());
+    std::vector<const Stop*> stops;
+    for (const auto& stop : catalogue.GetStops()) {
+        if (stop_to_vertex[stop.id] != NONE_VERTEX) {
+            stops.push_back(&stop);
+        }
+    }
+    const size_t thread_count = std::min(parallel::GetThreadCount(routing_settings.router_threads_),
+                                         std::max<size_t>(stops.size(), 1));
+
+    std::vector<BusEdges> thread_edges(thread_count);
+    parallel::ForEachThread(thread_count, [&](size_t thread_index) {
+        const auto [stops_begin, stops_end] = parallel::GetThreadShare(stops.size(), thread_index, thread_count);
+        BusEdges& walk_edges = thread_edges[thread_index];
+        for (size_t idx = stops_begin; idx < stops_end; ++idx) {
+            const VertexId from = stop_to_vertex[stops[idx]->id];
+            for (const auto& [stop, distance] : stop_index.FindWithin(stops[idx]->coordinates, radius)) {
+                const VertexId to = stop_to_vertex[stop->id];
+                if (to != NONE_VERTEX && to != from) {
+                    walk_edges.edges.push_back({ from, to, distance / meters_per_minute });
+                    walk_edges.bus_spans.push_back({nullptr, 0});
+                }
+            }
+        }
+    });
+
+    BusEdges walk_edges;
+    for (const auto& edges : thread_edges) {
+        walk_edges.edges.insert(walk_edges.edges.end(), edges.edges.begin(), edges.edges.end());
+        walk_edges.bus_spans.insert(walk_edges.bus_spans.end(), edges.bus_spans.begin(), edges.bus_spans.end());
+    }
+    std::cerr << "walking transfers: "sv << walk_edges.edges.size() << " edges between "sv << stops.size()
+              << " stops within "sv << radius << " m\n"sv;
+    return walk_edges;
+}
+
+// a dict for each route item, put into the array the builder has open; Route and TimedRoute answers share it
+void AddRouteItems(json::Builder& builder, const std::vector<RouteItem>& items) {
+    for (const auto& item : items) {
+        builder.StartDict();
+        switch (item.type)
+        {
+            case RouteReqestType::WAIT: builder.Key("type"s).Value("Wait"s)
+                .Key("stop_name"s).Value(std::string(*item.stop_name))
+                .Key("time"s).Value(item.time);
+                break;
+            case RouteReqestType::BUS: builder.Key("type"s).Value("Bus"s)
+                .Key("bus"s).Value(std::string(*item.bus_name))
+                .Key("time"s).Value(item.time)
+                .Key("span_count"s).Value(static_cast<int>(*item.span_count));
+                break;
+            case RouteReqestType::WALK: builder.Key("type"s).Value("Walk"s);
+                if (item.stop_name) {
+                    builder.Key("stop_name"s).Value(std::string(*item.stop_name));
+                }
+                if (item.to_stop_name) {
+                    builder.Key("to_stop_name"s).Value(std::string(*item.to_stop_name));
+                }
+                builder.Key("time"s).Value(item.time)
+                    .Key("distance"s).Value(*item.distance);
+                break;
+            default:
+                break;
+        }
+        builder.EndDict();
+    }
+}
+
+} // namespace
+
 Reader::Reader(std::istream& input)
     : document(json::Load(input))
 {
@@ -30,18 +237,26 @@ void Reader::MakeBase() {
     serialize.SetRenderSettings(std::move(render_settings));
 
 
-    static graph graph_(catalogue.GetStopCount() * 2);
-    BuildGraph(graph_);
-    BuildTransportRouter(graph_);
+    RoutingSettingsHandle();
 
-    const Dict& rs = document.GetRoot().AsDict().at("routing_settings"s).AsDict();
-    routing_settings = TRouter::RoutingSettings{ rs.at("bus_wait_time"s).AsDouble(),
-                                                rs.at("bus_velocity"s).AsDouble() };
+    graph graph_(GetGraphVertexCount());
+    BuildRoutingGraph(graph_);
+    if (routing_settings.router_type_ == RouterType::ALL_PAIRS && routing_settings.store_routing_table_) {
+        if (routing_settings.weight_ticks_per_minute_ > 0) {
+            tick_routes_table = Router<TickWeight>::BuildRoutesTable(
+                MakeTickGraph(graph_, routing_settings.weight_ticks_per_minute_), routing_settings.router_threads_);
+        } else {
+            routes_table = Router<double>::BuildRoutesTable(graph_, routing_settings.router_threads_);
+        }
+    }
 
     serialize.SetRoutingSettings(std::move(routing_settings));
     serialize.SetGraph(std::move(graph_));
-    serialize.SetStopToVertex(std::move(stop_to_vertex));
+    serialize.SetIdToStop(std::move(id_to_stop));
     serialize.SetEdgeToBusSpan(std::move(edge_to_bus_span));
+    serialize.SetContractionHierarchy(std::move(hierarchy));
+    serialize.SetRoutesTable(std::move(routes_table));
+    serialize.SetTickRoutesTable(std::move(tick_routes_table));
 
     serialize.Serialization(catalogue);
 }
@@ -55,18 +270,35 @@ void Reader::ProcessRequests() {
     serialize.Deserialization(catalogue);
     render_settings = serialize.GetRenderSettings();
     routing_settings = serialize.GetRoutingSettings();
-    stop_to_vertex = serialize.GetStopToVertex();
-    id_to_stop = serialize.GetIdToStop();
-    edge_to_bus_span = serialize.GetEdgeToBusSpan();
+    if (serialize.HasGraph()) {
+        stop_to_vertex = serialize.GetStopToVertex();
+        id_to_stop = serialize.GetIdToStop();
+        edge_to_bus_span = serialize.GetEdgeToBusSpan();
+        hierarchy = serialize.GetContractionHierarchy();
+        routes_table = serialize.GetRoutesTable();
+        tick_routes_table = serialize.GetTickRoutesTable();
 
-    graph graph_(std::move(serialize.GetGraph()));
-    BuildGraph(graph_);
-    BuildTransportRouter(graph_);
+        graph graph_(std::move(serialize.GetGraph()));
+        BuildTransportRouter(graph_);
+    } else {
+        // a base of an older version has no graph to use, it's built from the catalogue as make_base does
+        graph graph_(GetGraphVertexCount());
+        BuildRoutingGraph(graph_);
+        BuildTransportRouter(graph_);
+    }
+    timetable_router = std::make_unique<TRouter::TimetableRouter>(catalogue);
+    stop_index = std::make_unique<StopIndex>(catalogue.GetStops());
     // process requests
     StatRequestHandle();
     // reply
     // std::ofstream ofs("output.json"s);
     Reply(std::cout);
+
+    if (const auto statistics = (*router).GetTreeCacheStatistics()) {
+        std::cerr << "tree cache: "sv << (*statistics).hits << " hits, "sv << (*statistics).misses << " misses, "sv
+                  << (*statistics).evictions << " evictions, "sv << (*statistics).tree_count << " trees in "sv
+                  << (*statistics).memory_usage << " bytes\n"sv;
+    }
 }
 
 void Reader::Reply(std::ostream& output) const {
@@ -82,6 +314,7 @@ void Reader::BaseRequestHandle() {
 
     StopBaseRequestHandle(base_requests);
     BusBaseRequestHandle(base_requests);
+    TimetableBaseRequestHandle(base_requests);
 }
 
 void Reader::StopBaseRequestHandle(const Array& base_requests) {
@@ -132,6 +365,22 @@ void Reader::BusBaseRequestHandle(const Array& base_reauest) {
     }
 }
 
+void Reader::TimetableBaseRequestHandle(const Array& base_requests) {
+    for (const auto& request : base_requests) {
+        const Dict& dictionary = request.AsDict();
+        if (dictionary.at("type"s).AsString() == "Timetable"s) {
+            std::vector<Trip> trips;
+            for (const auto& trip : dictionary.at("trips"s).AsArray()) {
+                Trip& departures = trips.emplace_back();
+                for (const auto& departure : trip.AsArray()) {
+                    departures.push_back(departure.AsDouble());
+                }
+            }
+            catalogue.SetBusTrips(dictionary.at("bus"s).AsString(), std::move(trips));
+        }
+    }
+}
+
 void Reader::AgreeDistances(const std::vector<const domain::Stop*>& stops, int64_t& length, double& geo_length) const {
     const Stop* first = stops.front();
     const Stop* last;
@@ -145,9 +394,147 @@ void Reader::AgreeDistances(const std::vector<const domain::Stop*>& stops, int64
     }
 }
 
+void Reader::RoutingSettingsHandle() {
+    const Dict& rs = document.GetRoot().AsDict().at("routing_settings"s).AsDict();
+    routing_settings = TRouter::RoutingSettings{ rs.at("bus_wait_time"s).AsDouble(),
+                                                rs.at("bus_velocity"s).AsDouble() };
+
+    if (rs.count("router"s) > 0) {
+        const std::string& router_type = rs.at("router"s).AsString();
+        if (router_type == "all_pairs"s) {
+            routing_settings.router_type_ = RouterType::ALL_PAIRS;
+        } else if (router_type == "dijkstra"s) {
+            routing_settings.router_type_ = RouterType::DIJKSTRA;
+        } else if (router_type == "contraction_hierarchy"s) {
+            routing_settings.router_type_ = RouterType::CONTRACTION_HIERARCHY;
+        } else if (router_type == "a_star"s) {
+            routing_settings.router_type_ = RouterType::A_STAR;
+        } else if (router_type == "bidirectional"s) {
+            routing_settings.router_type_ = RouterType::BIDIRECTIONAL;
+        } else if (router_type == "shortest_path_trees"s) {
+            routing_settings.router_type_ = RouterType::SHORTEST_PATH_TREES;
+        } else {
+            throw std::invalid_argument("Unknown router type: "s + router_type);
+        }
+    }
+    if (rs.count("router_threads"s) > 0) {
+        routing_settings.router_threads_ = static_cast<size_t>(rs.at("router_threads"s).AsInt());
+    }
+    if (rs.count("store_routing_table"s) > 0) {
+        routing_settings.store_routing_table_ = rs.at("store_routing_table"s).AsBool();
+    }
+    if (rs.count("graph_model"s) > 0) {
+        const std::string& graph_model = rs.at("graph_model"s).AsString();
+        if (graph_model == "stop_pairs"s) {
+            routing_settings.graph_model_ = GraphModel::STOP_PAIRS;
+        } else if (graph_model == "transit"s) {
+            routing_settings.graph_model_ = GraphModel::TRANSIT;
+        } else {
+            throw std::invalid_argument("Unknown graph model: "s + graph_model);
+        }
+    }
+    if (rs.count("vertex_order"s) > 0) {
+        const std::string& vertex_order = rs.at("vertex_order"s).AsString();
+        if (vertex_order == "routes"s) {
+            routing_settings.vertex_order_ = VertexOrder::ROUTES;
+        } else if (vertex_order == "cuthill_mckee"s) {
+            routing_settings.vertex_order_ = VertexOrder::CUTHILL_MCKEE;
+        } else if (vertex_order == "hilbert"s) {
+            routing_settings.vertex_order_ = VertexOrder::HILBERT;
+        } else {
+            throw std::invalid_argument("Unknown vertex order: "s + vertex_order);
+        }
+    }
+    if (rs.count("tree_cache_size_mb"s) > 0) {
+        routing_settings.tree_cache_size_mb_ = static_cast<size_t>(rs.at("tree_cache_size_mb"s).AsInt());
+    }
+    if (rs.count("weight_ticks_per_minute"s) > 0) {
+        routing_settings.weight_ticks_per_minute_ = static_cast<size_t>(rs.at("weight_ticks_per_minute"s).AsInt());
+        if (routing_settings.weight_ticks_per_minute_ > 0
+            && (routing_settings.router_type_ == RouterType::CONTRACTION_HIERARCHY
+                || routing_settings.router_type_ == RouterType::A_STAR)) {
+            throw std::invalid_argument("Integer weights work with all_pairs, dijkstra, bidirectional "s
+                                        + "and shortest_path_trees routers only"s);
+        }
+    }
+    if (rs.count("walk_velocity"s) > 0) {
+        routing_settings.walk_velocity_ = rs.at("walk_velocity"s).AsDouble();
+        if (!(routing_settings.walk_velocity_ > 0)) {
+            throw std::invalid_argument("Walk velocity should be positive");
+        }
+    }
+    if (rs.count("walk_radius"s) > 0) {
+        routing_settings.walk_radius_ = rs.at("walk_radius"s).AsDouble();
+        if (!(routing_settings.walk_radius_ > 0)) {
+            throw std::invalid_argument("Walk radius should be positive");
+        }
+    }
+    if (rs.count("transfer_radius"s) > 0) {
+        routing_settings.transfer_radius_ = rs.at("transfer_radius"s).AsDouble();
+        if (routing_settings.transfer_radius_ < 0) {
+            throw std::invalid_argument("Transfer radius should be non-negative");
+        }
+    }
+}
+
 void Reader::StatRequestHandle() {
     const Array stat_requests(document.GetRoot().AsDict().at("stat_requests"s).AsArray());
 
+    // the whole batch is known, so the router gets the sources of routes between stops in advance;
+    // routes from or to a point are searched from the stops around it instead
+    std::vector<const Dict*> routes;
+    std::vector<std::string_view> route_sources;
+    for (const auto& request : stat_requests) {
+        if (request.AsDict().at("type"s).AsString() == "Route"s) {
+            const Dict& route = request.AsDict();
+            routes.push_back(&route);
+            if (route.at("from"s).IsString() && route.at("to"s).IsString()) {
+                route_sources.push_back(route.at("from"s).AsString());
+            }
+        }
+    }
+    if (!route_sources.empty()) {
+        (*router).PrepareSources(route_sources);
+    }
+
+    // a stop at one end of a route from or to a point is taken as a point too
+    const auto route_point = [this](const Node& end) -> std::optional<geo::Coordinates> {
+        if (const auto point = AsRoutePoint(end)) {
+            return point;
+        }
+        if (!catalogue.CheckStop(end.AsString())) {
+            return std::nullopt;
+        }
+        return catalogue.FindStop(end.AsString())->coordinates;
+    };
+    const auto route_info = [&](const Dict& route) -> std::optional<TRouter::RouteInfo> {
+        const Node& from = route.at("from"s);
+        const Node& to = route.at("to"s);
+        if (from.IsString() && to.IsString()) {
+            return (*router).GetRouteInfo(from.AsString(), to.AsString());
+        }
+        const auto from_point = route_point(from);
+        const auto to_point = route_point(to);
+        if (!from_point || !to_point) {
+            return std::nullopt;
+        }
+        return (*router).GetRouteInfo(*from_point, *to_point, *stop_index);
+    };
+
+    // then routes are searched on router_threads threads, each taking the next route as it's done with one;
+    // queries only read the router
+    const size_t route_count = routes.size();
+    std::vector<std::optional<TRouter::RouteInfo>> route_infos(route_count);
+    const size_t thread_count = std::min(parallel::GetThreadCount(GetRoutingSettings().router_threads_),
+                                         std::max<size_t>(route_count, 1));
+    std::atomic<size_t> next_route = 0;
+    parallel::ForEachThread(thread_count, [&](size_t /*thread_index*/) {
+        for (size_t idx = next_route++; idx < route_count; idx = next_route++) {
+            route_infos[idx] = route_info(*routes[idx]);
+        }
+    });
+
+    size_t route_idx = 0;
     for (const auto& request : stat_requests) {
         const auto& type = request.AsDict().at("type"s).AsString();
         if (type == "Stop"s) {
@@ -157,63 +544,363 @@ void Reader::StatRequestHandle() {
         } else if (type == "Map") {
             MapStatRequestHandle(request);
         } else if (type == "Route") {
-            RouterStatRequestHandle(request);
+            RouterStatRequestHandle(request, route_infos[route_idx++]);
+        } else if (type == "RouteMatrix") {
+            RouteMatrixStatRequestHandle(request);
+        } else if (type == "Reachable") {
+            ReachableStatRequestHandle(request);
+        } else if (type == "TimedRoute") {
+            TimedRouteStatRequestHandle(request);
+        } else if (type == "NearbyStops") {
+            NearbyStopsStatRequestHandle(request);
         }
     }
 }
 
-void Reader::BuildGraph(graph& graph_) {
+void Reader::RouteMatrixStatRequestHandle(const Node& request) {
+    const auto stop_names = [&request](const std::string& key) {
+        std::vector<std::string_view> names;
+        for (const auto& stop : request.AsDict().at(key).AsArray()) {
+            names.push_back(stop.AsString());
+        }
+        return names;
+    };
 
-    constexpr const static double M = 1'000;
-    constexpr const static double MIN = 60;
-    constexpr const static double CONVERSION = M / MIN;
+    const auto matrix = (*router).GetRouteMatrix(stop_names("from"s), stop_names("to"s));
 
-    const RoutingSettings routing_settings(GetRoutingSettings());
-    VertexId general_id = 0;
-    
+    json::Builder builder;
+    builder.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
+    builder.Key("total_times"s).StartArray();
+    for (const auto& row : matrix) {
+        builder.StartArray();
+        for (const auto& total_time : row) {
+            if (total_time) {
+                builder.Value(*total_time);
+            } else {
+                builder.Value(nullptr);
+            }
+        }
+        builder.EndArray();
+    }
+    builder.EndArray().EndDict();
+
+    stat_response.push_back(builder.Build());
+}
+
+void Reader::ReachableStatRequestHandle(const Node& request) {
+    json::Builder builder;
+    builder.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
+
+    const auto stops = (*router).GetReachableStops(request.AsDict().at("from"s).AsString(),
+                                                   request.AsDict().at("max_time"s).AsDouble());
+    if (!stops) {
+        builder.Key("error_message"s).Value("not found"s).EndDict();
+        stat_response.push_back(builder.Build());
+        return;
+    }
+
+    builder.Key("stops"s).StartArray();
+    for (const auto& [stop_name, time] : *stops) {
+        builder.StartDict()
+            .Key("stop_name"s).Value(static_cast<std::string>(stop_name))
+            .Key("time"s).Value(time)
+            .EndDict();
+    }
+    builder.EndArray().EndDict();
+
+    stat_response.push_back(builder.Build());
+}
+
+void Reader::NearbyStopsStatRequestHandle(const Node& request) {
+    const Dict& dictionary = request.AsDict();
+    const geo::Coordinates point{ dictionary.at("latitude"s).AsDouble(), dictionary.at("longitude"s).AsDouble() };
+
+    // the stops within radius, or the count nearest ones, or both: the count nearest within radius
+    std::vector<StopIndex::StopDistance> stops;
+    if (dictionary.count("radius"s) > 0) {
+        stops = (*stop_index).FindWithin(point, dictionary.at("radius"s).AsDouble());
+        if (dictionary.count("count"s) > 0) {
+            stops.resize(std::min(stops.size(), static_cast<size_t>(std::max(dictionary.at("count"s).AsInt(), 0))));
+        }
+    } else {
+        stops = (*stop_index).FindNearest(point, static_cast<size_t>(std::max(dictionary.at("count"s).AsInt(), 0)));
+    }
+
+    json::Builder builder;
+    builder.StartDict().Key("request_id"s).Value(dictionary.at("id"s).AsInt());
+    builder.Key("stops"s).StartArray();
+    for (const auto& [stop, distance] : stops) {
+        builder.StartDict()
+            .Key("stop_name"s).Value(stop->name_)
+            .Key("distance"s).Value(distance)
+            .EndDict();
+    }
+    builder.EndArray().EndDict();
+
+    stat_response.push_back(builder.Build());
+}
+
+size_t Reader::GetGraphVertexCount() const {
+    std::unordered_set<const Stop*> stops;
+    size_t route_stop_count = 0;
     for (const auto& bus : catalogue.GetBuses()) {
-        const auto& stops = bus.route_;
+        stops.insert(bus.route_.begin(), bus.route_.end());
+        route_stop_count += bus.route_.size();
+    }
+    if (GetRoutingSettings().graph_model_ == GraphModel::TRANSIT) {
+        return stops.size() + route_stop_count;
+    }
+    return stops.size();
+}
 
-        size_t start = 0;
-        for (auto stop = stops.begin(); stop + 1 != stops.end(); ++stop) {
+size_t Reader::AssignStopVertices(size_t vertex_count) {
+    stop_to_vertex.assign(catalogue.GetStopCount(), NONE_VERTEX);
+    id_to_stop.assign(vertex_count, nullptr);
 
-            VertexId from = general_id;
-            if (stop_to_vertex.count(*stop) > 0) {
-                from = stop_to_vertex[*stop];
-            } else {
-                stop_to_vertex[*stop] = from;
-                id_to_stop[from] = *stop;
+    VertexId general_id = 0;
+    for (const auto& bus : catalogue.GetBuses()) {
+        for (const Stop* stop : bus.route_) {
+            if (stop_to_vertex[stop->id] == NONE_VERTEX) {
+                stop_to_vertex[stop->id] = general_id;
+                id_to_stop[general_id] = stop;
                 ++general_id;
             }
+        }
+    }
+    return general_id;
+}
 
-            size_t count = 1; // count stops between start and next bus stop - span count
-            for (auto following_stop = stop + 1; following_stop != stops.end(); ++following_stop) {         
+void Reader::BuildGraph(graph& graph_) {
 
-                VertexId to = general_id;
-                if (stop_to_vertex.count(*following_stop) > 0) {
-                    to = stop_to_vertex[*following_stop];
-                }
-                else {
-                    stop_to_vertex[*following_stop] = to;
-                    id_to_stop[to] = *following_stop;
-                    ++general_id;
+    const RoutingSettings routing_settings(GetRoutingSettings());
+    AssignStopVertices(graph_.GetVertexCount());
+    const auto& buses = catalogue.GetBuses();
+
+    // an edge from each stop of a route to every following one
+    std::vector<size_t> bus_edge_counts;
+    bus_edge_counts.reserve(buses.size());
+    for (const auto& bus : buses) {
+        const size_t stop_count = bus.route_.size();
+        bus_edge_counts.push_back(stop_count > 1 ? stop_count * (stop_count - 1) / 2 : 0);
+    }
+
+    BusEdges graph_edges = CollectBusEdges(bus_edge_counts, routing_settings.router_threads_,
+        [&](size_t bus_index, BusEdges& bus_edges) {
+            const auto& bus = buses[bus_index];
+            const auto& stops = bus.route_;
+            for (size_t start = 0; start + 1 < stops.size(); ++start) {
+                const VertexId from = stop_to_vertex[stops[start]->id];
+                // count stops between start and next bus stop - span count
+                for (size_t count = 1; start + count < stops.size(); ++count) {
+                    bus_edges.edges.push_back({ from, stop_to_vertex[stops[start + count]->id], routing_settings.bus_wait_time_ +
+                        ((catalogue.GetDistance(&bus, start, count) * 1.0) / (routing_settings.bus_velocity_ * CONVERSION)) });
+                    bus_edges.bus_spans.push_back({&bus, count});
                 }
+            }
+        });
+
+    if (routing_settings.transfer_radius_ > 0) {
+        const BusEdges walk_edges = CollectWalkEdges(catalogue, stop_to_vertex, routing_settings);
+        graph_edges.edges.insert(graph_edges.edges.end(), walk_edges.edges.begin(), walk_edges.edges.end());
+        graph_edges.bus_spans.insert(graph_edges.bus_spans.end(), walk_edges.bus_spans.begin(), walk_edges.bus_spans.end());
+    }
+
+    // buses sharing a corridor give parallel edges, routes need only the lightest of them, be it a walk
+    const size_t edge_count = graph_edges.edges.size();
+    const size_t pruned_count = PruneDominatedEdges(graph_.GetVertexCount(), graph_edges);
+    std::cerr << "routing graph: "sv << pruned_count << " of "sv << edge_count << " edges pruned as dominated\n"sv;
+    AddBusEdges(graph_, edge_to_bus_span, graph_edges);
+}
+
+void Reader::BuildTransitGraph(graph& graph_) {
 
-                graph_.AddEdge({ from, to, routing_settings.bus_wait_time_  +
-                     ((catalogue.GetDistance(&bus, start, count) * 1.0) / (routing_settings.bus_velocity_ * CONVERSION)) });
+    const RoutingSettings routing_settings(GetRoutingSettings());
+    // stop vertices go first
+    const size_t stop_vertex_count = AssignStopVertices(graph_.GetVertexCount());
+    const auto& buses = catalogue.GetBuses();
 
-                edge_to_bus_span[{from, to}] = {&bus, count};
-                ++count;
+    // then a vertex per stop of each route: board before riding on, alight after riding in
+    std::vector<VertexId> first_on_bus_vertices;
+    std::vector<size_t> bus_edge_counts;
+    first_on_bus_vertices.reserve(buses.size());
+    bus_edge_counts.reserve(buses.size());
+    VertexId general_id = stop_vertex_count;
+    for (const auto& bus : buses) {
+        const size_t stop_count = bus.route_.size();
+        first_on_bus_vertices.push_back(general_id);
+        general_id += stop_count;
+        bus_edge_counts.push_back(stop_count > 0 ? (stop_count - 1) * 3 : 0);
+    }
+
+    const BusEdges graph_edges = CollectBusEdges(bus_edge_counts, routing_settings.router_threads_,
+        [&](size_t bus_index, BusEdges& bus_edges) {
+            const auto& bus = buses[bus_index];
+            const auto& stops = bus.route_;
+            for (size_t idx = 0; idx < stops.size(); ++idx) {
+                const VertexId stop_vertex = stop_to_vertex[stops[idx]->id];
+                const VertexId on_bus = first_on_bus_vertices[bus_index] + idx;
+                if (idx + 1 < stops.size()) {
+                    bus_edges.edges.push_back({ stop_vertex, on_bus, routing_settings.bus_wait_time_ });
+                    bus_edges.bus_spans.push_back({nullptr, 0});
+                    bus_edges.edges.push_back({ on_bus, on_bus + 1,
+                        (catalogue.GetDistance(&bus, idx, 1) * 1.0) / (routing_settings.bus_velocity_ * CONVERSION) });
+                    bus_edges.bus_spans.push_back({&bus, 1});
+                }
+                if (idx > 0) {
+                    bus_edges.edges.push_back({ on_bus, stop_vertex, .0 });
+                    bus_edges.bus_spans.push_back({nullptr, 0});
+                }
             }
-            ++start;
+        });
+    // no pruning here: every bus edge has the on bus vertex of its own route stop at one end, so none are parallel,
+    // and walking edges join stop vertices only
+    AddBusEdges(graph_, edge_to_bus_span, graph_edges);
+    if (routing_settings.transfer_radius_ > 0) {
+        AddBusEdges(graph_, edge_to_bus_span, CollectWalkEdges(catalogue, stop_to_vertex, routing_settings));
+    }
+}
+
+void Reader::BuildRoutingGraph(graph& graph_) {
+    if (GetRoutingSettings().graph_model_ == GraphModel::TRANSIT) {
+        BuildTransitGraph(graph_);
+    } else {
+        BuildGraph(graph_);
+    }
+    if (GetRoutingSettings().vertex_order_ != VertexOrder::ROUTES) {
+        ReorderVertices(graph_);
+    }
+    graph_.Freeze();
+    if (GetRoutingSettings().router_type_ == RouterType::CONTRACTION_HIERARCHY) {
+        hierarchy = ContractionHierarchyBuilder<double>(graph_).Build();
+    }
+}
+
+std::vector<geo::Coordinates> Reader::GetVertexCoordinates(const graph& graph_) const {
+    std::vector<geo::Coordinates> vertex_coordinates(graph_.GetVertexCount(), geo::Coordinates{ .0, .0 });
+    for (VertexId vertex = 0; vertex < id_to_stop.size(); ++vertex) {
+        if (const Stop* stop = id_to_stop[vertex]) {
+            vertex_coordinates[vertex] = stop->coordinates;
+        }
+    }
+    // a vertex on a bus is where it's boarded or alighted
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        const bool is_from_stop = id_to_stop[edge.from] != nullptr;
+        const bool is_to_stop = id_to_stop[edge.to] != nullptr;
+        if (is_from_stop && !is_to_stop) {
+            vertex_coordinates[edge.to] = vertex_coordinates[edge.from];
+        } else if (!is_from_stop && is_to_stop) {
+            vertex_coordinates[edge.from] = vertex_coordinates[edge.to];
         }
     }
+    return vertex_coordinates;
+}
+
+void Reader::ReorderVertices(graph& graph_) {
+    std::vector<VertexId> new_ids;
+    if (GetRoutingSettings().vertex_order_ == VertexOrder::CUTHILL_MCKEE) {
+        new_ids = ComputeCuthillMcKeeOrder(graph_);
+    } else {
+        std::vector<std::pair<double, double>> points;
+        points.reserve(graph_.GetVertexCount());
+        for (const auto& coordinates : GetVertexCoordinates(graph_)) {
+            points.emplace_back(coordinates.lng, coordinates.lat);
+        }
+        new_ids = ComputeHilbertOrder(points);
+    }
+
+    // edges keep their ids, so bus spans stay as they are
+    graph reordered_graph(graph_.GetVertexCount());
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        reordered_graph.AddEdge({ new_ids[edge.from], new_ids[edge.to], edge.weight });
+    }
+    VertexId_Stop reordered_stops(id_to_stop.size(), nullptr);
+    for (VertexId vertex = 0; vertex < id_to_stop.size(); ++vertex) {
+        reordered_stops[new_ids[vertex]] = id_to_stop[vertex];
+    }
+    for (auto& vertex : stop_to_vertex) {
+        if (vertex != NONE_VERTEX) {
+            vertex = new_ids[vertex];
+        }
+    }
+
+    id_to_stop = std::move(reordered_stops);
+    graph_ = std::move(reordered_graph);
+}
+
+std::unique_ptr<RouterBase<double>> Reader::BuildTickWeightRouter(const graph& graph_) {
+    auto tick_graph = std::make_unique<TickGraph>(MakeTickGraph(graph_, GetRoutingSettings().weight_ticks_per_minute_));
+
+    std::unique_ptr<RouterBase<TickWeight>> router_ptr = nullptr;
+    switch (GetRoutingSettings().router_type_) {
+        case RouterType::DIJKSTRA:
+            router_ptr = std::make_unique<DijkstraRouter<TickWeight>>(*tick_graph);
+            break;
+        case RouterType::BIDIRECTIONAL:
+            router_ptr = std::make_unique<BidirectionalRouter<TickWeight>>(*tick_graph);
+            break;
+        case RouterType::SHORTEST_PATH_TREES:
+            router_ptr = std::make_unique<ShortestPathTreeRouter<TickWeight>>(*tick_graph);
+            break;
+        case RouterType::ALL_PAIRS:
+            if (!tick_routes_table.IsEmpty()) {
+                router_ptr = std::make_unique<Router<TickWeight>>(*tick_graph, std::move(tick_routes_table));
+            } else {
+                router_ptr = std::make_unique<Router<TickWeight>>(*tick_graph, GetRoutingSettings().router_threads_);
+            }
+            break;
+        default:
+            throw std::invalid_argument("Router doesn't support integer weights");
+    }
+    return std::make_unique<TickWeightRouter>(graph_, std::move(tick_graph), std::move(router_ptr));
 }
 
 void Reader::BuildTransportRouter(graph& graph_) {
+    auto graph_ptr = std::make_unique<graph>(graph_);
+    (*graph_ptr).Freeze();
+
+    std::unique_ptr<RouterBase<double>> router_ptr = nullptr;
+    if (GetRoutingSettings().weight_ticks_per_minute_ > 0) {
+        router_ptr = BuildTickWeightRouter(*graph_ptr);
+    } else {
+        switch (GetRoutingSettings().router_type_) {
+            case RouterType::DIJKSTRA:
+                router_ptr = std::make_unique<DijkstraRouter<double>>(*graph_ptr);
+                break;
+            case RouterType::CONTRACTION_HIERARCHY:
+                router_ptr = std::make_unique<ContractionHierarchyRouter<double>>(*graph_ptr, std::move(hierarchy));
+                break;
+            case RouterType::BIDIRECTIONAL:
+                router_ptr = std::make_unique<BidirectionalRouter<double>>(*graph_ptr);
+                break;
+            case RouterType::SHORTEST_PATH_TREES:
+                router_ptr = std::make_unique<ShortestPathTreeRouter<double>>(*graph_ptr);
+                break;
+            case RouterType::A_STAR: {
+                std::vector<bool> stop_vertices((*graph_ptr).GetVertexCount(), false);
+                for (VertexId vertex = 0; vertex < id_to_stop.size(); ++vertex) {
+                    stop_vertices[vertex] = id_to_stop[vertex] != nullptr;
+                }
+                router_ptr = std::make_unique<AStarRouter<double, StopDistancePotential>>(*graph_ptr,
+                    StopDistancePotential(GetVertexCoordinates(*graph_ptr), std::move(stop_vertices), *graph_ptr,
+                        edge_to_bus_span, GetRoutingSettings()));
+                break;
+            }
+            case RouterType::ALL_PAIRS:
+            default:
+                if (!routes_table.IsEmpty()) {
+                    router_ptr = std::make_unique<Router<double>>(*graph_ptr, std::move(routes_table));
+                } else {
+                    router_ptr = std::make_unique<Router<double>>(*graph_ptr, GetRoutingSettings().router_threads_);
+                }
+                break;
+        }
+    }
+
     router = std::move(std::make_unique<TRouter::TransportRouter>(TRouter::TransportRouter{
-        std::move(std::make_unique<graph>(graph_)), 
-        std::move(std::make_unique<Router<double>>(Router<double>{graph_})),
+        std::move(graph_ptr), 
+        std::move(router_ptr),
         std::move(std::make_unique<Stop_VertexId>(stop_to_vertex)),
         std::move(std::make_unique<Edge_BusSpan>(edge_to_bus_span)),
         std::move(std::make_unique<VertexId_Stop>(id_to_stop)),
@@ -289,22 +976,22 @@ void Reader::MapStatRequestHandle(const Node& request) {
     stat_response.push_back(builder.Build());
 }
 
-void Reader::RouterStatRequestHandle(const Node& request) {
+void Reader::RouterStatRequestHandle(const Node& request, const std::optional<TRouter::RouteInfo>& route_info) {
 
     json::Builder builder;
     builder.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
 
-    std::string_view from = request.AsDict().at("from"s).AsString();
-    std::string_view to = request.AsDict().at("to"s).AsString();
+    // a route from or to a point may walk to and from stops no bus goes through
+    const Node& from = request.AsDict().at("from"s);
+    const Node& to = request.AsDict().at("to"s);
 
-    if (catalogue.GetBusesInStop(from).size() == 0 || catalogue.GetBusesInStop(to).size() == 0) {
+    if (from.IsString() && to.IsString()
+        && (catalogue.GetBusesInStop(from.AsString()).size() == 0 || catalogue.GetBusesInStop(to.AsString()).size() == 0)) {
         builder.Key("error_message"s).Value("not found"s).EndDict();
         stat_response.push_back(builder.Build());
         return;
     }
 
-    const auto& route_info = (*router).GetRouteInfo(from, to);
-    
     if (!route_info) {
         builder.Key("error_message"s).Value("not found"s).EndDict();
         stat_response.push_back(builder.Build());
@@ -313,25 +1000,28 @@ void Reader::RouterStatRequestHandle(const Node& request) {
     
     builder.Key("total_time"s).Value(json::Node((*route_info).total_time).AsDouble());
     builder.Key("items"s).StartArray();
+    AddRouteItems(builder, (*route_info).items);
+    builder.EndArray().EndDict();
+    stat_response.push_back(builder.Build());
+}
 
-    for (const auto& item : (*route_info).items) {
-        builder.StartDict();
-        switch (item.type)
-        {
-            case RouteReqestType::WAIT: builder.Key("type"s).Value("Wait"s)
-                .Key("stop_name"s).Value(json::Node(static_cast<std::string>(*(item.stop_name))).AsString())
-                .Key("time"s).Value(json::Node(item.time).AsDouble());
-                break;
-            case RouteReqestType::BUS: builder.Key("type"s).Value("Bus"s)
-                .Key("bus"s).Value(json::Node(static_cast<std::string>(*(item.bus_name))).AsString())
-                .Key("time"s).Value(json::Node(item.time).AsDouble())
-                .Key("span_count"s).Value(json::Node(static_cast<int>(*(item.span_count))).AsInt());
-                break;
-            default:
-                break;
-        }
-        builder.EndDict();
+void Reader::TimedRouteStatRequestHandle(const Node& request) {
+    json::Builder builder;
+    builder.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
+
+    const auto route_info = (*timetable_router).GetTimedRouteInfo(request.AsDict().at("from"s).AsString(),
+        request.AsDict().at("to"s).AsString(), request.AsDict().at("departure_time"s).AsDouble());
+    if (!route_info) {
+        builder.Key("error_message"s).Value("not found"s).EndDict();
+        stat_response.push_back(builder.Build());
+        return;
     }
+
+    builder.Key("arrival_time"s).Value((*route_info).arrival_time);
+    builder.Key("total_time"s).Value((*route_info).arrival_time - (*route_info).departure_time);
+    builder.Key("transfers"s).Value(static_cast<int>((*route_info).transfers));
+    builder.Key("items"s).StartArray();
+    AddRouteItems(builder, (*route_info).items);
     builder.EndArray().EndDict();
     stat_response.push_back(builder.Build());
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "transport_catalogue.h"
+#include "stop_index.h"
 #include "transport_router.h"
+#include "timetable_router.h"
 #include "map_renderer.h"
 #include "geo.h"
 #include "domain.h"
@@ -12,6 +14,7 @@
 #include <variant>
 #include <unordered_map>
 #include <memory>
+#include <optional>
 
 namespace JsonReader {
 
@@ -22,9 +25,9 @@ using namespace domain;
 using namespace graph;
 using namespace TRouter;
 
-using Stop_VertexId = std::unordered_map<const Stop*, VertexId>;
-using VertexId_Stop = std::unordered_map<VertexId, const Stop*>;
-using Edge_BusSpan = std::unordered_map<std::pair<VertexId, VertexId>, std::pair<const Bus*, size_t>, HacherPair>;
+using Stop_VertexId = std::vector<VertexId>; // indexed by stop id, NONE_VERTEX for stops on no bus
+using VertexId_Stop = std::vector<const Stop*>; // indexed by vertex id, nullptr for vertices which aren't stops
+using Edge_BusSpan = std::vector<std::pair<const Bus*, size_t>>; // indexed by edge id, nullptr bus for edges which aren't rides
 
 class Reader {
 public:
@@ -48,26 +51,53 @@ private:
     Array stat_response;
 
     std::unique_ptr<TRouter::TransportRouter> router;
+    std::unique_ptr<TRouter::TimetableRouter> timetable_router;
+    std::unique_ptr<StopIndex> stop_index;
 
     Stop_VertexId stop_to_vertex;
     VertexId_Stop id_to_stop;
 
     Edge_BusSpan edge_to_bus_span;
 
+    ContractionHierarchy<double> hierarchy;
+    RoutesTable<double> routes_table;
+    RoutesTable<TickWeight> tick_routes_table;
+
     void Reply(std::ostream& output) const;
 
     void BaseRequestHandle();
     void StopBaseRequestHandle(const Array& base_requests);
     void BusBaseRequestHandle(const Array& base_reauest);
+    // sets bus timetables, goes after the buses
+    void TimetableBaseRequestHandle(const Array& base_requests);
     void AgreeDistances(const std::vector<const domain::Stop*>& stops, int64_t& lenght, double& geo_length) const;
+    void RoutingSettingsHandle();
 
     void StatRequestHandle();
     void StopStatRequestHandle(const Node& request);
     void BusStatRequestHandle(const Node& request);
     void MapStatRequestHandle(const Node& request);
-    void RouterStatRequestHandle(const Node& request);
-
+    void RouterStatRequestHandle(const Node& request, const std::optional<TRouter::RouteInfo>& route_info);
+    void RouteMatrixStatRequestHandle(const Node& request);
+    void ReachableStatRequestHandle(const Node& request);
+    void TimedRouteStatRequestHandle(const Node& request);
+    void NearbyStopsStatRequestHandle(const Node& request);
+
+    size_t GetGraphVertexCount() const;
+    // fills stop_to_vertex and id_to_stop, giving stops vertex ids in order of their first appearance on routes;
+    // returns the number of stop vertices
+    size_t AssignStopVertices(size_t vertex_count);
     void BuildGraph(graph& graph_);
+    void BuildTransitGraph(graph& graph_);
+    // the graph of routing_settings.graph_model_ in routing_settings.vertex_order_, frozen, with the contraction
+    // hierarchy when it's the router
+    void BuildRoutingGraph(graph& graph_);
+    // coordinates by vertex id, a vertex on a bus gets the ones of its stop
+    std::vector<geo::Coordinates> GetVertexCoordinates(const graph& graph_) const;
+    // renumbers the vertices by routing_settings.vertex_order_ keeping edge ids
+    void ReorderVertices(graph& graph_);
+    // engine over the graph copy with integer weights, by routing_settings.weight_ticks_per_minute_
+    std::unique_ptr<RouterBase<double>> BuildTickWeightRouter(const graph& graph_);
     void BuildTransportRouter(graph& graph_);
 };
 
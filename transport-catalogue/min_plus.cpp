@@ -0,0 +1,207 @@
+#include "min_plus.h"
+
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MIN_PLUS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace min_plus {
+
+namespace {
+
+using Kernel = void (*)(double*, uint32_t*, double, uint32_t, const double*, const uint32_t*, size_t, size_t);
+using IntegerKernel = void (*)(uint32_t*, uint32_t*, uint32_t, uint32_t, const uint32_t*, const uint32_t*, size_t, size_t);
+
+constexpr uint32_t UNREACHABLE = std::numeric_limits<uint32_t>::max();
+
+void RelaxRowScalar(double* weights, uint32_t* prev_edges, double through_weight, uint32_t through_prev_edge,
+                    const double* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+        const double candidate_weight = through_weight + pivot_weights[idx];
+        if (candidate_weight < weights[idx]) {
+            weights[idx] = candidate_weight;
+            prev_edges[idx] = pivot_prev_edges[idx] != NONE_EDGE ? pivot_prev_edges[idx] : through_prev_edge;
+        }
+    }
+}
+
+void RelaxRowScalar(uint32_t* weights, uint32_t* prev_edges, uint32_t through_weight, uint32_t through_prev_edge,
+                    const uint32_t* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    for (size_t idx = begin; idx < end; ++idx) {
+        if (pivot_weights[idx] == UNREACHABLE) {
+            continue;
+        }
+        const uint32_t candidate_weight = through_weight + pivot_weights[idx];
+        if (candidate_weight < weights[idx]) {
+            weights[idx] = candidate_weight;
+            prev_edges[idx] = pivot_prev_edges[idx] != NONE_EDGE ? pivot_prev_edges[idx] : through_prev_edge;
+        }
+    }
+}
+
+#ifdef MIN_PLUS_X86_KERNELS
+
+// four cells a step: the 64-bit lanes of the weights' compare mask are narrowed to 32-bit lanes
+// to blend the edge ids
+__attribute__((target("avx2")))
+void RelaxRowAvx2(double* weights, uint32_t* prev_edges, double through_weight, uint32_t through_prev_edge,
+                  const double* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    const __m256d through = _mm256_set1_pd(through_weight);
+    const __m128i through_prev = _mm_set1_epi32(static_cast<int>(through_prev_edge));
+    const __m128i none_edge = _mm_set1_epi32(static_cast<int>(NONE_EDGE));
+    const __m256i even_lanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    size_t idx = begin;
+    for (; idx + 4 <= end; idx += 4) {
+        const __m256d candidate = _mm256_add_pd(through, _mm256_loadu_pd(pivot_weights + idx));
+        const __m256d current = _mm256_loadu_pd(weights + idx);
+        const __m256d is_better = _mm256_cmp_pd(candidate, current, _CMP_LT_OQ);
+        if (_mm256_movemask_pd(is_better) == 0) {
+            continue;
+        }
+        _mm256_storeu_pd(weights + idx, _mm256_blendv_pd(current, candidate, is_better));
+
+        const __m128i is_better_ids = _mm256_castsi256_si128(
+            _mm256_permutevar8x32_epi32(_mm256_castpd_si256(is_better), even_lanes));
+        const __m128i pivot_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pivot_prev_edges + idx));
+        const __m128i candidate_prev = _mm_blendv_epi8(pivot_prev, through_prev, _mm_cmpeq_epi32(pivot_prev, none_edge));
+        __m128i* prev = reinterpret_cast<__m128i*>(prev_edges + idx);
+        _mm_storeu_si128(prev, _mm_blendv_epi8(_mm_loadu_si128(prev), candidate_prev, is_better_ids));
+    }
+    RelaxRowScalar(weights, prev_edges, through_weight, through_prev_edge, pivot_weights, pivot_prev_edges, idx, end);
+}
+
+// two cells a step, the edge ids are moved as 64-bit halves of the registers
+__attribute__((target("sse4.1")))
+void RelaxRowSse41(double* weights, uint32_t* prev_edges, double through_weight, uint32_t through_prev_edge,
+                   const double* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    const __m128d through = _mm_set1_pd(through_weight);
+    const __m128i through_prev = _mm_set1_epi32(static_cast<int>(through_prev_edge));
+    const __m128i none_edge = _mm_set1_epi32(static_cast<int>(NONE_EDGE));
+
+    size_t idx = begin;
+    for (; idx + 2 <= end; idx += 2) {
+        const __m128d candidate = _mm_add_pd(through, _mm_loadu_pd(pivot_weights + idx));
+        const __m128d current = _mm_loadu_pd(weights + idx);
+        const __m128d is_better = _mm_cmplt_pd(candidate, current);
+        if (_mm_movemask_pd(is_better) == 0) {
+            continue;
+        }
+        _mm_storeu_pd(weights + idx, _mm_blendv_pd(current, candidate, is_better));
+
+        const __m128i is_better_ids = _mm_castps_si128(
+            _mm_shuffle_ps(_mm_castpd_ps(is_better), _mm_castpd_ps(is_better), _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i pivot_prev = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pivot_prev_edges + idx));
+        const __m128i candidate_prev = _mm_blendv_epi8(pivot_prev, through_prev, _mm_cmpeq_epi32(pivot_prev, none_edge));
+        __m128i* prev = reinterpret_cast<__m128i*>(prev_edges + idx);
+        _mm_storel_epi64(prev, _mm_blendv_epi8(_mm_loadl_epi64(prev), candidate_prev, is_better_ids));
+    }
+    RelaxRowScalar(weights, prev_edges, through_weight, through_prev_edge, pivot_weights, pivot_prev_edges, idx, end);
+}
+
+// eight cells a step; there is no unsigned compare, so a cell isn't improved where the unsigned minimum
+// of the candidate and the current weight is the current one
+__attribute__((target("avx2")))
+void RelaxRowAvx2(uint32_t* weights, uint32_t* prev_edges, uint32_t through_weight, uint32_t through_prev_edge,
+                  const uint32_t* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    const __m256i through = _mm256_set1_epi32(static_cast<int>(through_weight));
+    const __m256i through_prev = _mm256_set1_epi32(static_cast<int>(through_prev_edge));
+    const __m256i none_edge = _mm256_set1_epi32(static_cast<int>(NONE_EDGE));
+    const __m256i unreachable = _mm256_set1_epi32(static_cast<int>(UNREACHABLE));
+
+    size_t idx = begin;
+    for (; idx + 8 <= end; idx += 8) {
+        const __m256i pivot = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pivot_weights + idx));
+        const __m256i candidate = _mm256_add_epi32(through, pivot);
+        __m256i* current_ptr = reinterpret_cast<__m256i*>(weights + idx);
+        const __m256i current = _mm256_loadu_si256(current_ptr);
+        const __m256i is_kept = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(candidate, current), current),
+                                                _mm256_cmpeq_epi32(pivot, unreachable));
+        if (_mm256_movemask_epi8(is_kept) == -1) {
+            continue;
+        }
+        _mm256_storeu_si256(current_ptr, _mm256_blendv_epi8(candidate, current, is_kept));
+
+        const __m256i pivot_prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pivot_prev_edges + idx));
+        const __m256i candidate_prev = _mm256_blendv_epi8(pivot_prev, through_prev, _mm256_cmpeq_epi32(pivot_prev, none_edge));
+        __m256i* prev = reinterpret_cast<__m256i*>(prev_edges + idx);
+        _mm256_storeu_si256(prev, _mm256_blendv_epi8(candidate_prev, _mm256_loadu_si256(prev), is_kept));
+    }
+    RelaxRowScalar(weights, prev_edges, through_weight, through_prev_edge, pivot_weights, pivot_prev_edges, idx, end);
+}
+
+// four cells a step, the same way as the AVX2 one
+__attribute__((target("sse4.1")))
+void RelaxRowSse41(uint32_t* weights, uint32_t* prev_edges, uint32_t through_weight, uint32_t through_prev_edge,
+                   const uint32_t* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    const __m128i through = _mm_set1_epi32(static_cast<int>(through_weight));
+    const __m128i through_prev = _mm_set1_epi32(static_cast<int>(through_prev_edge));
+    const __m128i none_edge = _mm_set1_epi32(static_cast<int>(NONE_EDGE));
+    const __m128i unreachable = _mm_set1_epi32(static_cast<int>(UNREACHABLE));
+
+    size_t idx = begin;
+    for (; idx + 4 <= end; idx += 4) {
+        const __m128i pivot = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pivot_weights + idx));
+        const __m128i candidate = _mm_add_epi32(through, pivot);
+        __m128i* current_ptr = reinterpret_cast<__m128i*>(weights + idx);
+        const __m128i current = _mm_loadu_si128(current_ptr);
+        const __m128i is_kept = _mm_or_si128(_mm_cmpeq_epi32(_mm_min_epu32(candidate, current), current),
+                                             _mm_cmpeq_epi32(pivot, unreachable));
+        if (_mm_movemask_epi8(is_kept) == 0xFFFF) {
+            continue;
+        }
+        _mm_storeu_si128(current_ptr, _mm_blendv_epi8(candidate, current, is_kept));
+
+        const __m128i pivot_prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pivot_prev_edges + idx));
+        const __m128i candidate_prev = _mm_blendv_epi8(pivot_prev, through_prev, _mm_cmpeq_epi32(pivot_prev, none_edge));
+        __m128i* prev = reinterpret_cast<__m128i*>(prev_edges + idx);
+        _mm_storeu_si128(prev, _mm_blendv_epi8(candidate_prev, _mm_loadu_si128(prev), is_kept));
+    }
+    RelaxRowScalar(weights, prev_edges, through_weight, through_prev_edge, pivot_weights, pivot_prev_edges, idx, end);
+}
+
+#endif
+
+struct KernelChoice {
+    Kernel kernel;
+    IntegerKernel integer_kernel;
+    const char* name;
+};
+
+const KernelChoice& GetKernelChoice() {
+    static const KernelChoice choice = [] {
+#ifdef MIN_PLUS_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return KernelChoice{RelaxRowAvx2, RelaxRowAvx2, "avx2"};
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return KernelChoice{RelaxRowSse41, RelaxRowSse41, "sse4.1"};
+        }
+#endif
+        return KernelChoice{RelaxRowScalar, RelaxRowScalar, "scalar"};
+    }();
+    return choice;
+}
+
+}  // namespace
+
+void RelaxRow(double* weights, uint32_t* prev_edges, double through_weight, uint32_t through_prev_edge,
+              const double* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    GetKernelChoice().kernel(weights, prev_edges, through_weight, through_prev_edge,
+                             pivot_weights, pivot_prev_edges, begin, end);
+}
+
+void RelaxRow(uint32_t* weights, uint32_t* prev_edges, uint32_t through_weight, uint32_t through_prev_edge,
+              const uint32_t* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end) {
+    GetKernelChoice().integer_kernel(weights, prev_edges, through_weight, through_prev_edge,
+                                     pivot_weights, pivot_prev_edges, begin, end);
+}
+
+const char* GetKernelName() {
+    return GetKernelChoice().name;
+}
+
+}  // namespace min_plus
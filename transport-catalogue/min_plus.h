@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace min_plus {
+
+// last edge id of a route which has no edges
+inline constexpr uint32_t NONE_EDGE = std::numeric_limits<uint32_t>::max();
+
+// Min-plus update of row cells [begin, end) through a pivot: where through_weight + pivot_weights[i]
+// is less than weights[i] the weight is replaced and prev_edges[i] becomes pivot_prev_edges[i],
+// or through_prev_edge when the pivot route has no edges. Unreachable cells hold infinity.
+// Runs an AVX2 or SSE4.1 kernel when the CPU supports it and a scalar loop otherwise,
+// all of them giving the same result.
+void RelaxRow(double* weights, uint32_t* prev_edges, double through_weight, uint32_t through_prev_edge,
+              const double* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end);
+
+// The same over integer weights, where unreachable cells hold the maximum value and pivot cells
+// holding it are skipped. Sums must not overflow.
+void RelaxRow(uint32_t* weights, uint32_t* prev_edges, uint32_t through_weight, uint32_t through_prev_edge,
+              const uint32_t* pivot_weights, const uint32_t* pivot_prev_edges, size_t begin, size_t end);
+
+// name of the kernel chosen for this CPU: "avx2", "sse4.1" or "scalar"
+const char* GetKernelName();
+
+}  // namespace min_plus
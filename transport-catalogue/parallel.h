@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+
+// requested thread count, zero stands for all hardware threads
+inline size_t GetThreadCount(size_t requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// Reusable barrier: Wait returns once thread_count threads have called it
+class Barrier {
+public:
+    explicit Barrier(size_t thread_count)
+        : thread_count_(thread_count) {
+    }
+
+    void Wait() {
+        std::unique_lock lock(mutex_);
+        const size_t generation = generation_;
+        if (++waiting_ == thread_count_) {
+            waiting_ = 0;
+            ++generation_;
+            condition_.notify_all();
+            return;
+        }
+        condition_.wait(lock, [this, generation] { return generation != generation_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    const size_t thread_count_;
+    size_t waiting_ = 0;
+    size_t generation_ = 0;
+};
+
+// Calls func(thread_index) on thread_count threads, the calling one included, and waits for all of them.
+// The first exception thrown by func is rethrown to the caller; func which meets the others at a Barrier
+// must not throw.
+template <typename Func>
+void ForEachThread(size_t thread_count, Func func) {
+    if (thread_count <= 1) {
+        func(0);
+        return;
+    }
+
+    std::exception_ptr exception = nullptr;
+    std::mutex exception_mutex;
+    const auto run = [&func, &exception, &exception_mutex](size_t thread_index) {
+        try {
+            func(thread_index);
+        } catch (...) {
+            std::lock_guard guard(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+        threads.emplace_back(run, thread_index);
+    }
+    run(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+// [begin, end) part of count items which falls to thread_index of thread_count threads
+inline std::pair<size_t, size_t> GetThreadShare(size_t count, size_t thread_index, size_t thread_count) {
+    return {count * thread_index / thread_count, count * (thread_index + 1) / thread_count};
+}
+
+}  // namespace parallel
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_ARM64))
+#define RADIX_HEAP_BIT_SCAN_REVERSE_64
+#include <intrin.h>
+#endif
+
+namespace graph {
+
+// Monotone priority queue over unsigned integer keys: a pushed key must be no less than the last popped
+// one, which holds for Dijkstra over non-negative weights. An item sits in the bucket of the highest bit
+// where its key differs from the last popped key. A pop from an empty bucket zero moves the first
+// non-empty bucket down, so every item moves at most once per key bit and items are never compared.
+template <typename Key, typename Value>
+class RadixHeap {
+    static_assert(std::is_unsigned_v<Key>, "Radix heap keys should be unsigned integers");
+
+public:
+    using Item = std::pair<Key, Value>;
+
+    void Clear() {
+        for (auto& bucket : buckets_) {
+            bucket.clear();
+        }
+        size_ = 0;
+        last_key_ = 0;
+    }
+
+    bool IsEmpty() const {
+        return size_ == 0;
+    }
+
+    void Push(Key key, Value value) {
+        buckets_[GetBucket(key)].push_back({key, value});
+        ++size_;
+    }
+
+    // one of the items with the least key, the heap must not be empty
+    const Item& Top() {
+        Settle();
+        return buckets_.front().back();
+    }
+
+    Item Pop() {
+        Settle();
+        const Item item = buckets_.front().back();
+        buckets_.front().pop_back();
+        --size_;
+        return item;
+    }
+
+private:
+    static constexpr size_t BUCKET_COUNT = std::numeric_limits<Key>::digits + 1;
+
+    size_t GetBucket(Key key) const {
+        return GetBitWidth(static_cast<uint64_t>(key ^ last_key_));
+    }
+
+    // number of bits up to the highest set one, zero for zero
+    static size_t GetBitWidth(uint64_t value) {
+        if (value == 0) {
+            return 0;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        return 64 - __builtin_clzll(value);
+#elif defined(RADIX_HEAP_BIT_SCAN_REVERSE_64)
+        unsigned long highest_bit = 0;
+        _BitScanReverse64(&highest_bit, value);
+        return highest_bit + 1;
+#else
+        size_t width = 0;
+        for (; value != 0; value >>= 1) {
+            ++width;
+        }
+        return width;
+#endif
+    }
+
+    // makes bucket zero hold the least key
+    void Settle() {
+        if (!buckets_.front().empty()) {
+            return;
+        }
+        size_t bucket_idx = 1;
+        while (buckets_[bucket_idx].empty()) {
+            ++bucket_idx;
+        }
+        auto& bucket = buckets_[bucket_idx];
+        last_key_ = bucket.front().first;
+        for (const Item& item : bucket) {
+            last_key_ = std::min(last_key_, item.first);
+        }
+        // all the keys of the bucket share the bits above bucket_idx with the new last key, so they go lower
+        for (const Item& item : bucket) {
+            buckets_[GetBucket(item.first)].push_back(item);
+        }
+        bucket.clear();
+    }
+
+    std::array<std::vector<Item>, BUCKET_COUNT> buckets_;
+    size_t size_ = 0;
+    Key last_key_ = 0;
+};
+
+}  // namespace graph
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "graph.h"
+#include "min_plus.h"
+#include "parallel.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -15,103 +19,304 @@
 namespace graph {
 
 template <typename Weight>
-class Router {
-private:
-    using Graph = DirectedWeightedGraph<Weight>;
-
+class RouterBase {
 public:
-    explicit Router(const Graph& graph);
-
     struct RouteInfo {
         Weight weight;
         std::vector<EdgeId> edges;
     };
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    virtual ~RouterBase() = default;
+
+    virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
 
+    // hint that routes from sources are about to be built, engines which precompute per source
+    // do it here on thread_count threads
+    virtual void PrepareSources(const std::vector<VertexId>& /*sources*/, size_t /*thread_count*/) {
+    }
+};
+
+// Weights and last edges of the best routes between all vertices, each in its own contiguous
+// row-major vertex_count x vertex_count plane: 12 bytes per cell for double weights.
+// Unreachable cells hold UNREACHABLE, routes without edges hold NONE_EDGE.
+template <typename Weight>
+struct RoutesTable {
+    using CompactEdgeId = uint32_t;
+
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+                                          ? std::numeric_limits<Weight>::infinity()
+                                          : std::numeric_limits<Weight>::max();
+    static constexpr CompactEdgeId NONE_EDGE = min_plus::NONE_EDGE;
+
+    size_t vertex_count = 0;
+    std::vector<Weight> weights;
+    std::vector<CompactEdgeId> prev_edges;
+
+    bool IsEmpty() const {
+        return weights.empty();
+    }
+
+    Weight* GetWeights(VertexId from) {
+        return weights.data() + from * vertex_count;
+    }
+    const Weight* GetWeights(VertexId from) const {
+        return weights.data() + from * vertex_count;
+    }
+    CompactEdgeId* GetPrevEdges(VertexId from) {
+        return prev_edges.data() + from * vertex_count;
+    }
+    const CompactEdgeId* GetPrevEdges(VertexId from) const {
+        return prev_edges.data() + from * vertex_count;
+    }
+};
+
+template <typename Weight>
+class Router final : public RouterBase<Weight> {
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    // rows of the table are relaxed on thread_count threads, zero means all hardware threads
+    explicit Router(const Graph& graph, size_t thread_count = 1);
+    // takes a table computed earlier for the same graph
+    Router(const Graph& graph, RoutesTable<Weight>&& routes_table);
+
+    // computes the table without keeping a router, e.g. to store it with the graph
+    static RoutesTable<Weight> BuildRoutesTable(const Graph& graph, size_t thread_count = 1) {
+        Router router(graph, thread_count);
+        return std::move(router.routes_internal_data_);
+    }
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    using CompactEdgeId = typename RoutesTable<Weight>::CompactEdgeId;
+
+    // Pivots are taken in blocks of PIVOT_BLOCK_SIZE. Rows of a block's pivots are copied at the
+    // moment they are used as in plain Floyd-Warshall, then every other row applies the whole block
+    // one COLUMN_TILE_SIZE tile at a time, so the tile of the row and of the pivot rows stay in cache.
+    // Each cell still sees pivots in increasing order with exactly the same operands, so the table
+    // is identical to the one of the plain algorithm.
+    static constexpr size_t PIVOT_BLOCK_SIZE = 32;
+    static constexpr size_t COLUMN_TILE_SIZE = 512;
+
+    struct PivotBlock {
+        VertexId begin = 0;
+        VertexId end = 0;
+        std::vector<Weight> weights;
+        std::vector<CompactEdgeId> prev_edges;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+
+    static constexpr Weight UNREACHABLE = RoutesTable<Weight>::UNREACHABLE;
+    static constexpr CompactEdgeId NONE_EDGE = RoutesTable<Weight>::NONE_EDGE;
 
     void InitializeRoutesInternalData(const Graph& graph) {
         const size_t vertex_count = graph.GetVertexCount();
+        if (graph.GetEdgeCount() >= NONE_EDGE) {
+            throw std::length_error("Too many edges for the routing table");
+        }
+        routes_internal_data_.vertex_count = vertex_count;
+        routes_internal_data_.weights.assign(vertex_count * vertex_count, UNREACHABLE);
+        routes_internal_data_.prev_edges.assign(vertex_count * vertex_count, NONE_EDGE);
+
         for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+            Weight* weights = routes_internal_data_.GetWeights(vertex);
+            CompactEdgeId* prev_edges = routes_internal_data_.GetPrevEdges(vertex);
+            weights[vertex] = ZERO_WEIGHT;
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                if (weights[edge.to] > edge.weight) {
+                    weights[edge.to] = edge.weight;
+                    prev_edges[edge.to] = static_cast<CompactEdgeId>(edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // min-plus update of row cells [begin, end) through a pivot whose row is pivot_weights
+    static void RelaxRow(Weight* weights, CompactEdgeId* prev_edges, Weight through_weight,
+                         CompactEdgeId through_prev_edge, const Weight* pivot_weights,
+                         const CompactEdgeId* pivot_prev_edges, size_t begin, size_t end) {
+        if constexpr (std::is_same_v<Weight, double> || std::is_same_v<Weight, uint32_t>) {
+            min_plus::RelaxRow(weights, prev_edges, through_weight, through_prev_edge,
+                               pivot_weights, pivot_prev_edges, begin, end);
+        } else {
+            for (size_t vertex_to = begin; vertex_to < end; ++vertex_to) {
+                if constexpr (!std::numeric_limits<Weight>::has_infinity) {
+                    if (pivot_weights[vertex_to] == UNREACHABLE) {
+                        continue;
+                    }
+                }
+                const Weight candidate_weight = through_weight + pivot_weights[vertex_to];
+                if (candidate_weight < weights[vertex_to]) {
+                    weights[vertex_to] = candidate_weight;
+                    prev_edges[vertex_to] = pivot_prev_edges[vertex_to] != NONE_EDGE ? pivot_prev_edges[vertex_to]
+                                                                                      : through_prev_edge;
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
+    // relaxes the rows of the block's pivots themselves, copying each pivot row just before it's used
+    void RelaxPivotRows(PivotBlock& block) {
+        const size_t vertex_count = routes_internal_data_.vertex_count;
+        for (VertexId vertex_through = block.begin; vertex_through < block.end; ++vertex_through) {
+            const size_t offset = (vertex_through - block.begin) * vertex_count;
+            std::copy_n(routes_internal_data_.GetWeights(vertex_through), vertex_count, block.weights.begin() + offset);
+            std::copy_n(routes_internal_data_.GetPrevEdges(vertex_through), vertex_count,
+                        block.prev_edges.begin() + offset);
+
+            for (VertexId vertex_from = block.begin; vertex_from < block.end; ++vertex_from) {
+                Weight* weights = routes_internal_data_.GetWeights(vertex_from);
+                CompactEdgeId* prev_edges = routes_internal_data_.GetPrevEdges(vertex_from);
+                if (vertex_from == vertex_through || weights[vertex_through] == UNREACHABLE) {
+                    continue;
                 }
+                RelaxRow(weights, prev_edges, weights[vertex_through], prev_edges[vertex_through],
+                         block.weights.data() + offset, block.prev_edges.data() + offset, 0, vertex_count);
+            }
+        }
+    }
+
+    // relaxes rows [vertex_from_begin, vertex_from_end) outside of the block through all of its pivots
+    void RelaxRowsThroughBlock(const PivotBlock& block, VertexId vertex_from_begin, VertexId vertex_from_end) {
+        const size_t vertex_count = routes_internal_data_.vertex_count;
+        const size_t block_size = block.end - block.begin;
+        const auto relax_through_block = [&](VertexId vertex_from, size_t begin, size_t end,
+                                             const Weight* through_weights, const CompactEdgeId* through_prev_edges) {
+            Weight* weights = routes_internal_data_.GetWeights(vertex_from);
+            CompactEdgeId* prev_edges = routes_internal_data_.GetPrevEdges(vertex_from);
+            for (size_t idx = 0; idx < block_size; ++idx) {
+                if (through_weights[idx] != UNREACHABLE) {
+                    RelaxRow(weights, prev_edges, through_weights[idx], through_prev_edges[idx],
+                             block.weights.data() + idx * vertex_count, block.prev_edges.data() + idx * vertex_count,
+                             begin, end);
+                }
+            }
+        };
+
+        // the pivots' own columns go first, one pivot at a time, remembering each route to a pivot
+        // as it is right before the pivot is used
+        const size_t row_count = vertex_from_end - vertex_from_begin;
+        std::vector<Weight> through_weights(row_count * block_size);
+        std::vector<CompactEdgeId> through_prev_edges(row_count * block_size);
+        std::vector<VertexId> rows;
+        rows.reserve(row_count);
+        for (VertexId vertex_from = vertex_from_begin; vertex_from < vertex_from_end; ++vertex_from) {
+            if (block.begin <= vertex_from && vertex_from < block.end) {
+                continue;
+            }
+            Weight* weights = routes_internal_data_.GetWeights(vertex_from);
+            CompactEdgeId* prev_edges = routes_internal_data_.GetPrevEdges(vertex_from);
+            const size_t offset = rows.size() * block_size;
+            bool is_reaching_block = false;
+            for (size_t idx = 0; idx < block_size; ++idx) {
+                const VertexId vertex_through = block.begin + idx;
+                through_weights[offset + idx] = weights[vertex_through];
+                through_prev_edges[offset + idx] = prev_edges[vertex_through];
+                if (weights[vertex_through] != UNREACHABLE) {
+                    is_reaching_block = true;
+                    RelaxRow(weights, prev_edges, weights[vertex_through], prev_edges[vertex_through],
+                             block.weights.data() + idx * vertex_count, block.prev_edges.data() + idx * vertex_count,
+                             block.begin, block.end);
+                }
+            }
+            if (is_reaching_block) {
+                rows.push_back(vertex_from);
+            }
+        }
+
+        for (size_t tile_begin = 0; tile_begin < vertex_count; tile_begin += COLUMN_TILE_SIZE) {
+            const size_t tile_end = std::min(tile_begin + COLUMN_TILE_SIZE, vertex_count);
+            for (size_t idx = 0; idx < rows.size(); ++idx) {
+                const Weight* row_through_weights = through_weights.data() + idx * block_size;
+                const CompactEdgeId* row_through_prev_edges = through_prev_edges.data() + idx * block_size;
+                // the pivots' columns are already done
+                relax_through_block(rows[idx], tile_begin, std::min(tile_end, block.begin),
+                                    row_through_weights, row_through_prev_edges);
+                relax_through_block(rows[idx], std::max(tile_begin, block.end), tile_end,
+                                    row_through_weights, row_through_prev_edges);
             }
         }
     }
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    RoutesTable<Weight> routes_internal_data_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, size_t thread_count)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
 {
     InitializeRoutesInternalData(graph);
 
     const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    thread_count = std::min(parallel::GetThreadCount(thread_count), std::max<size_t>(vertex_count, 1));
+
+    PivotBlock block;
+    block.weights.resize(std::min(PIVOT_BLOCK_SIZE, vertex_count) * vertex_count);
+    block.prev_edges.resize(block.weights.size());
+
+    // the pivot rows are relaxed by the first thread, then all threads share the other rows
+    parallel::Barrier barrier(thread_count);
+    parallel::ForEachThread(thread_count, [&](size_t thread_index) {
+        const auto [vertex_from_begin, vertex_from_end] =
+            parallel::GetThreadShare(vertex_count, thread_index, thread_count);
+        for (VertexId pivot_begin = 0; pivot_begin < vertex_count; pivot_begin += PIVOT_BLOCK_SIZE) {
+            if (thread_index == 0) {
+                block.begin = pivot_begin;
+                block.end = std::min(pivot_begin + PIVOT_BLOCK_SIZE, vertex_count);
+                RelaxPivotRows(block);
+            }
+            barrier.Wait();
+            RelaxRowsThroughBlock(block, vertex_from_begin, vertex_from_end);
+            barrier.Wait();
+        }
+    });
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, RoutesTable<Weight>&& routes_table)
+    : graph_(graph)
+    , routes_internal_data_(std::move(routes_table))
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    if (routes_internal_data_.vertex_count != vertex_count
+        || routes_internal_data_.weights.size() != vertex_count * vertex_count
+        || routes_internal_data_.prev_edges.size() != vertex_count * vertex_count) {
+        throw std::invalid_argument("Routing table doesn't match the graph");
     }
 }
 
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    const size_t vertex_count = routes_internal_data_.vertex_count;
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+    const Weight* weights = routes_internal_data_.GetWeights(from);
+    const CompactEdgeId* prev_edges = routes_internal_data_.GetPrevEdges(from);
+    if (weights[to] == UNREACHABLE) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    const Weight weight = weights[to];
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (CompactEdgeId edge_id = prev_edges[to];
+         edge_id != NONE_EDGE;
+         edge_id = prev_edges[graph_.GetEdge(edge_id).from])
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
     return RouteInfo{weight, std::move(edges)};
 }
 
-}  // namespace graph
\ No newline at end of file
+}  // namespace graph
@@ -11,14 +11,49 @@
 #include <map_renderer.pb.h>
 #include <transport_catalogue.pb.h>
 
+#include <cstring>
 #include <fstream>
 #include <filesystem>
 #include <memory>
+#include <stdexcept>
 
 #include <iostream>
 
 namespace serial {
 
+namespace {
+
+// the planes are written as raw memory, so loading them is a copy
+template <typename Weight>
+void WriteRoutesTable(const RoutesTable<Weight>& routes_table, proto_graph::RoutesTable& pb_routes_table) {
+    pb_routes_table.set_vertex_count(routes_table.vertex_count);
+    pb_routes_table.set_weights(reinterpret_cast<const char*>(routes_table.weights.data()),
+                                routes_table.weights.size() * sizeof(Weight));
+    pb_routes_table.set_prev_edges(reinterpret_cast<const char*>(routes_table.prev_edges.data()),
+                                   routes_table.prev_edges.size() * sizeof(typename RoutesTable<Weight>::CompactEdgeId));
+}
+
+template <typename Weight>
+RoutesTable<Weight> ReadRoutesTable(const proto_graph::RoutesTable& pb_routes_table) {
+    RoutesTable<Weight> routes_table;
+    if (!pb_routes_table.weights().empty()) {
+        const size_t cell_count = pb_routes_table.vertex_count() * pb_routes_table.vertex_count();
+        if (pb_routes_table.weights().size() != cell_count * sizeof(Weight)
+            || pb_routes_table.prev_edges().size() != cell_count * sizeof(typename RoutesTable<Weight>::CompactEdgeId)) {
+            throw std::runtime_error("Routing table in the base is damaged");
+        }
+        routes_table.vertex_count = pb_routes_table.vertex_count();
+        routes_table.weights.resize(cell_count);
+        routes_table.prev_edges.resize(cell_count);
+        std::memcpy(routes_table.weights.data(), pb_routes_table.weights().data(), pb_routes_table.weights().size());
+        std::memcpy(routes_table.prev_edges.data(), pb_routes_table.prev_edges().data(),
+                    pb_routes_table.prev_edges().size());
+    }
+    return routes_table;
+}
+
+} // namespace
+
 void SerialTC::SetSerializationSettings(SerializationSettings&& ss) {
     serialization_settings = std::make_unique<SerializationSettings>(std::forward<SerializationSettings>(ss));
 }
@@ -55,6 +90,10 @@ SerialTC::graph&& SerialTC::GetGraph() {
     return std::move(*graph_ptr.release());
 }
 
+bool SerialTC::HasGraph() const {
+    return graph_ptr != nullptr;
+}
+
 void SerialTC::SetStopToVertex(Stop_VertexId&& stop_to_vertex_){
     stop_to_vertex = std::move(std::make_unique<Stop_VertexId>(std::forward<Stop_VertexId>(stop_to_vertex_)));
 }
@@ -82,6 +121,33 @@ Edge_BusSpan&& SerialTC::GetEdgeToBusSpan() {
     return std::move(*edge_to_bus_span.release());
 }
 
+void SerialTC::SetContractionHierarchy(ContractionHierarchy<double>&& hierarchy_) {
+    hierarchy = std::move(std::make_unique<ContractionHierarchy<double>>(std::forward<ContractionHierarchy<double>>(hierarchy_)));
+}
+
+ContractionHierarchy<double>&& SerialTC::GetContractionHierarchy() {
+    assert(hierarchy);
+    return std::move(*hierarchy.release());
+}
+
+void SerialTC::SetRoutesTable(RoutesTable<double>&& routes_table_) {
+    routes_table = std::move(std::make_unique<RoutesTable<double>>(std::forward<RoutesTable<double>>(routes_table_)));
+}
+
+RoutesTable<double>&& SerialTC::GetRoutesTable() {
+    assert(routes_table);
+    return std::move(*routes_table.release());
+}
+
+void SerialTC::SetTickRoutesTable(RoutesTable<TRouter::TickWeight>&& tick_routes_table_) {
+    tick_routes_table = std::move(std::make_unique<RoutesTable<TRouter::TickWeight>>(std::forward<RoutesTable<TRouter::TickWeight>>(tick_routes_table_)));
+}
+
+RoutesTable<TRouter::TickWeight>&& SerialTC::GetTickRoutesTable() {
+    assert(tick_routes_table);
+    return std::move(*tick_routes_table.release());
+}
+
 void SerialTC::SerializeCatalogue(const Catalogue::TransportCatalogue& catalogue, 
                                                 proto_tc::TransportCatalogue& pb_catalogue) {
  
@@ -124,6 +190,9 @@ void SerialTC::SerializeCatalogue(const Catalogue::TransportCatalogue& catalogue
         pb_bus.set_geo_length(bus.geo_length_);
         pb_bus.set_is_roundtrip(bus.is_roundtrip_);
         pb_bus.set_last_stop(bus.last_stop_->id);
+        for(const auto& trip : bus.trips_) {
+            *pb_bus.add_trips()->mutable_departures() = {trip.begin(), trip.end()};
+        }
 
         *pb_catalogue.mutable_buses(idx++) = std::move(pb_bus);
     }
@@ -203,13 +272,24 @@ void SerialTC::SerializeRenderSettings(proto_map_render::RenderSettings& pb_rend
     }
 }
 
-void SerialTC::SerializeRouter(proto_tr::TransportRouter& pb_router) {
+void SerialTC::SerializeRouter(const Catalogue::TransportCatalogue& catalogue, proto_tr::TransportRouter& pb_router) {
 
     proto_tr::RoutingSettings pb_routing_settings;
     pb_routing_settings.set_bus_velocity((*routing_settings).bus_velocity_);
     pb_routing_settings.set_bus_wait_time((*routing_settings).bus_wait_time_);
+    pb_routing_settings.set_router_type(static_cast<proto_tr::RouterType>((*routing_settings).router_type_));
+    pb_routing_settings.set_router_threads((*routing_settings).router_threads_);
+    pb_routing_settings.set_store_routing_table((*routing_settings).store_routing_table_);
+    pb_routing_settings.set_tree_cache_size_mb((*routing_settings).tree_cache_size_mb_);
+    pb_routing_settings.set_graph_model(static_cast<proto_tr::GraphModel>((*routing_settings).graph_model_));
+    pb_routing_settings.set_vertex_order(static_cast<proto_tr::VertexOrder>((*routing_settings).vertex_order_));
+    pb_routing_settings.set_weight_ticks_per_minute((*routing_settings).weight_ticks_per_minute_);
+    pb_routing_settings.set_walk_velocity((*routing_settings).walk_velocity_);
+    pb_routing_settings.set_walk_radius((*routing_settings).walk_radius_);
+    pb_routing_settings.set_transfer_radius((*routing_settings).transfer_radius_);
     *pb_router.mutable_routing_setting() = std::move(pb_routing_settings);
 
+    pb_router.set_vertex_count((*graph_ptr).GetVertexCount());
     size_t edges_count = (*graph_ptr).GetEdgeCount();
     for(auto idx = 0; idx < edges_count; ++idx) {
         proto_graph::Edge pb_edge;
@@ -221,25 +301,43 @@ void SerialTC::SerializeRouter(proto_tr::TransportRouter& pb_router) {
         *pb_router.mutable_graph(idx) = std::move(pb_edge);
     }
 
-    size_t idx = 0;
-    for(const auto& [key, value] : *(stop_to_vertex)) {
-        proto_tr::Stop_VertexId pb_stop_vertex;
-        pb_stop_vertex.set_stop_id(key->id);
-        pb_stop_vertex.set_vertex_id(value);
-        pb_router.add_stop_vertex();
-        *pb_router.mutable_stop_vertex(idx++) = std::move(pb_stop_vertex);
+    pb_router.mutable_vertex_stop()->Reserve((*id_to_stop).size());
+    for(const Stop* stop : *(id_to_stop)) {
+        pb_router.add_vertex_stop(stop != nullptr ? stop->id + 1 : 0);
     }
 
-    idx = 0;
-    for(const auto& [key, value] : *(edge_to_bus_span)) {
-        proto_tr::Edge_BusSpan pb_edge_to_bus_span;
-        pb_edge_to_bus_span.set_vertex_from(key.first);
-        pb_edge_to_bus_span.set_vetex_to(key.second);
-        pb_edge_to_bus_span.set_bus_name(value.first->name_);
-        pb_edge_to_bus_span.set_span_count(value.second);
-
-        pb_router.add_edge_bus_span();
-        *pb_router.mutable_edge_bus_span(idx++) = std::move(pb_edge_to_bus_span);
+    // buses are stored in catalogue order, so a bus is referred by its index
+    std::unordered_map<const Bus*, uint32_t> bus_indexes;
+    for(const auto& bus : catalogue.GetBuses()) {
+        bus_indexes.emplace(&bus, static_cast<uint32_t>(bus_indexes.size()));
+    }
+    pb_router.mutable_edge_bus()->Reserve((*edge_to_bus_span).size());
+    pb_router.mutable_edge_span_count()->Reserve((*edge_to_bus_span).size());
+    for(const auto& [bus, span_count] : *(edge_to_bus_span)) {
+        pb_router.add_edge_bus(bus != nullptr ? bus_indexes.at(bus) + 1 : 0);
+        pb_router.add_edge_span_count(span_count);
+    }
+
+    if (hierarchy && !(*hierarchy).IsEmpty()) {
+        proto_graph::ContractionHierarchy& pb_hierarchy = *pb_router.mutable_contraction_hierarchy();
+        for (const size_t rank : (*hierarchy).vertex_rank) {
+            pb_hierarchy.add_vertex_rank(rank);
+        }
+        for (const auto& shortcut : (*hierarchy).shortcuts) {
+            proto_graph::Shortcut& pb_shortcut = *pb_hierarchy.add_shortcuts();
+            pb_shortcut.set_from(shortcut.from);
+            pb_shortcut.set_to(shortcut.to);
+            pb_shortcut.set_weight(shortcut.weight);
+            pb_shortcut.set_first_edge(shortcut.first_edge);
+            pb_shortcut.set_second_edge(shortcut.second_edge);
+        }
+    }
+
+    // the table of whichever weights the settings use
+    if (routes_table && !(*routes_table).IsEmpty()) {
+        WriteRoutesTable(*routes_table, *pb_router.mutable_routes_table());
+    } else if (tick_routes_table && !(*tick_routes_table).IsEmpty()) {
+        WriteRoutesTable(*tick_routes_table, *pb_router.mutable_routes_table());
     }
 }
 
@@ -255,7 +353,7 @@ bool SerialTC::Serialization(const Catalogue::TransportCatalogue& catalogue) {
     *general_data.mutable_renderer_settings() = std::move(pb_render_settings);
 
     proto_tr::TransportRouter pb_router;
-    SerializeRouter(pb_router);
+    SerializeRouter(catalogue, pb_router);
     *general_data.mutable_tr() = std::move(pb_router);
 
     // serialize 
@@ -270,6 +368,12 @@ void SerialTC::DeserializeCatalogue(const proto_tc::TransportCatalogue& pb_catal
         catalogue.AddStop(pb_stop.id(), pb_stop.name(), pb_stop.lat(), pb_stop.lng());
     }
 
+    // distances go before buses, so buses count their route distances once
+    for(const auto& distance : pb_catalogue.distances()) {
+        catalogue.AddDistance(pb_catalogue.stops(distance.stop_x()).name(), 
+            pb_catalogue.stops(distance.stop_y()).name(), distance.distance());
+    }
+
     for(const auto& bus: pb_catalogue.buses()) {
         
         std::vector<const domain::Stop*> route;
@@ -279,13 +383,12 @@ void SerialTC::DeserializeCatalogue(const proto_tc::TransportCatalogue& pb_catal
            route.push_back(catalogue.FindStop(pb_catalogue.stops(stop_id).name()));
         }
 
-        catalogue.AddBus(domain::Bus{ bus.name(), std::move(route), bus.unique_size(), bus.length_(), bus.geo_length(), 
-            bus.is_roundtrip(), catalogue.FindStop(pb_catalogue.stops(bus.last_stop()).name())});
-    }
-
-    for(const auto& distance : pb_catalogue.distances()) {
-        catalogue.AddDistance(pb_catalogue.stops(distance.stop_x()).name(), 
-            pb_catalogue.stops(distance.stop_y()).name(), distance.distance());
+        domain::Bus domain_bus{ bus.name(), std::move(route), bus.unique_size(), bus.length_(), bus.geo_length(), 
+            bus.is_roundtrip(), catalogue.FindStop(pb_catalogue.stops(bus.last_stop()).name())};
+        for(const auto& trip : bus.trips()) {
+            domain_bus.trips_.emplace_back(trip.departures().begin(), trip.departures().end());
+        }
+        catalogue.AddBus(std::move(domain_bus));
     }
 }
 
@@ -358,32 +461,74 @@ void SerialTC::DeserializeTransportRouter(const proto_tr::TransportRouter& pb_ro
     proto_tr::RoutingSettings pb_routing_settings = pb_router.routing_setting();
     local_rs.bus_velocity_ = pb_routing_settings.bus_velocity();
     local_rs.bus_wait_time_ = pb_routing_settings.bus_wait_time();
+    local_rs.router_type_ = static_cast<TRouter::RouterType>(pb_routing_settings.router_type());
+    local_rs.router_threads_ = pb_routing_settings.router_threads();
+    local_rs.store_routing_table_ = pb_routing_settings.store_routing_table();
+    local_rs.tree_cache_size_mb_ = pb_routing_settings.tree_cache_size_mb();
+    local_rs.graph_model_ = static_cast<TRouter::GraphModel>(pb_routing_settings.graph_model());
+    local_rs.vertex_order_ = static_cast<TRouter::VertexOrder>(pb_routing_settings.vertex_order());
+    local_rs.weight_ticks_per_minute_ = pb_routing_settings.weight_ticks_per_minute();
+    // bases written before walking was added keep the defaults
+    if (pb_routing_settings.walk_velocity() > 0) {
+        local_rs.walk_velocity_ = pb_routing_settings.walk_velocity();
+    }
+    if (pb_routing_settings.walk_radius() > 0) {
+        local_rs.walk_radius_ = pb_routing_settings.walk_radius();
+    }
+    local_rs.transfer_radius_ = pb_routing_settings.transfer_radius();
     SetRoutingSettings(std::move(local_rs));
-    
-    graph graph_(catalogue.GetStopCount() * 2);
+
+    // bases written before the vertex metadata was stored have no way to tell stops from vertices, and the first
+    // of them weigh every edge as infinite, as the graph was built before the routing settings were read;
+    // the graph of such a base isn't read, process_requests builds it again
+    if (pb_router.vertex_stop_size() == 0 && pb_router.graph_size() > 0) {
+        return;
+    }
+
+    graph graph_(pb_router.vertex_count());
     for(const auto& pb_edge : pb_router.graph()) {
         graph_.AddEdge(Edge<double>{static_cast<size_t>(pb_edge.from()), 
                     static_cast<size_t>(pb_edge.to()), pb_edge.weight()});
     }
     SetGraph(std::move(graph_));
     
-    Stop_VertexId stop_to_vertex;
-    VertexId_Stop id_to_stop;
-    for(const auto& pb_stop_to_vertex : pb_router.stop_vertex()) {
-        const auto& stop_id = pb_stop_to_vertex.stop_id();
-        const auto& vertex_id = pb_stop_to_vertex.vertex_id();
-
-        stop_to_vertex[catalogue.FindStop(stop_id)] = vertex_id;
-        id_to_stop[vertex_id] = catalogue.FindStop(stop_id);
+    Stop_VertexId stop_to_vertex(catalogue.GetStopCount(), TRouter::NONE_VERTEX);
+    VertexId_Stop id_to_stop(pb_router.vertex_stop_size(), nullptr);
+    for(size_t vertex_id = 0; vertex_id < id_to_stop.size(); ++vertex_id) {
+        if (const uint32_t stop_id = pb_router.vertex_stop(vertex_id); stop_id > 0) {
+            id_to_stop[vertex_id] = catalogue.FindStop(stop_id - 1);
+            stop_to_vertex[stop_id - 1] = vertex_id;
+        }
     }
     SetStopToVertex(std::move(stop_to_vertex));
     SetIdToStop(std::move(id_to_stop));
-    Edge_BusSpan edge_to_bus_span;
-    for(const auto& pb_edge_to_bus_span : pb_router.edge_bus_span()) {
-        edge_to_bus_span[{pb_edge_to_bus_span.vertex_from(), pb_edge_to_bus_span.vetex_to()}] = 
-            {catalogue.FindBus(pb_edge_to_bus_span.bus_name()), pb_edge_to_bus_span.span_count()};
+
+    const auto& buses = catalogue.GetBuses();
+    Edge_BusSpan edge_to_bus_span(pb_router.edge_bus_size(), {nullptr, 0});
+    for(size_t edge_id = 0; edge_id < edge_to_bus_span.size(); ++edge_id) {
+        if (const uint32_t bus_index = pb_router.edge_bus(edge_id); bus_index > 0) {
+            edge_to_bus_span[edge_id] = {&buses[bus_index - 1], pb_router.edge_span_count(edge_id)};
+        }
     }
     SetEdgeToBusSpan(std::move(edge_to_bus_span));
+
+    ContractionHierarchy<double> hierarchy_;
+    const proto_graph::ContractionHierarchy& pb_hierarchy = pb_router.contraction_hierarchy();
+    hierarchy_.vertex_rank.assign(pb_hierarchy.vertex_rank().begin(), pb_hierarchy.vertex_rank().end());
+    hierarchy_.shortcuts.reserve(pb_hierarchy.shortcuts_size());
+    for(const auto& pb_shortcut : pb_hierarchy.shortcuts()) {
+        hierarchy_.shortcuts.push_back({static_cast<size_t>(pb_shortcut.from()), static_cast<size_t>(pb_shortcut.to()),
+            pb_shortcut.weight(), static_cast<size_t>(pb_shortcut.first_edge()), static_cast<size_t>(pb_shortcut.second_edge())});
+    }
+    SetContractionHierarchy(std::move(hierarchy_));
+
+    if (local_rs.weight_ticks_per_minute_ > 0) {
+        SetRoutesTable(RoutesTable<double>{});
+        SetTickRoutesTable(ReadRoutesTable<TRouter::TickWeight>(pb_router.routes_table()));
+    } else {
+        SetRoutesTable(ReadRoutesTable<double>(pb_router.routes_table()));
+        SetTickRoutesTable(RoutesTable<TRouter::TickWeight>{});
+    }
 }
 
 bool SerialTC::Deserialization(Catalogue::TransportCatalogue& catalogue) {
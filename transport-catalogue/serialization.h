@@ -28,9 +28,9 @@ struct SerializationSettings {
     std::string file; 
 };
 
-using Stop_VertexId = std::unordered_map<const Stop*, size_t>;
-using VertexId_Stop = std::unordered_map<size_t, const Stop*>;
-using Edge_BusSpan = std::unordered_map<std::pair<size_t, size_t>, std::pair<const Bus*, size_t>, HacherPair>;
+using Stop_VertexId = std::vector<VertexId>; // indexed by stop id, NONE_VERTEX for stops on no bus
+using VertexId_Stop = std::vector<const Stop*>; // indexed by vertex id, nullptr for vertices which aren't stops
+using Edge_BusSpan = std::vector<std::pair<const Bus*, size_t>>; // indexed by edge id, nullptr bus for edges which aren't rides
 
 class SerialTC {
 public:
@@ -51,6 +51,8 @@ public:
 
     void SetGraph(graph&& graph_ptr_);
     graph&& GetGraph();
+    // false after reading a base whose graph has to be built again, the graph and its metadata aren't set then
+    bool HasGraph() const;
 
     void SetStopToVertex(Stop_VertexId&& stop_to_vertex_);
     Stop_VertexId&& GetStopToVertex();
@@ -61,6 +63,15 @@ public:
     void SetEdgeToBusSpan(Edge_BusSpan&& edge_to_bus_span_);
     Edge_BusSpan&& GetEdgeToBusSpan();
 
+    void SetContractionHierarchy(ContractionHierarchy<double>&& hierarchy_);
+    ContractionHierarchy<double>&& GetContractionHierarchy();
+
+    void SetRoutesTable(RoutesTable<double>&& routes_table_);
+    RoutesTable<double>&& GetRoutesTable();
+
+    void SetTickRoutesTable(RoutesTable<TRouter::TickWeight>&& tick_routes_table_);
+    RoutesTable<TRouter::TickWeight>&& GetTickRoutesTable();
+
 private:
     std::unique_ptr<SerializationSettings> serialization_settings = nullptr;
     std::unique_ptr<renderer::RenderSettings> render_settings = nullptr;
@@ -69,11 +80,14 @@ private:
     std::unique_ptr<Stop_VertexId> stop_to_vertex = nullptr;
     std::unique_ptr<VertexId_Stop> id_to_stop = nullptr;
     std::unique_ptr<Edge_BusSpan> edge_to_bus_span = nullptr;
+    std::unique_ptr<ContractionHierarchy<double>> hierarchy = nullptr;
+    std::unique_ptr<RoutesTable<double>> routes_table = nullptr;
+    std::unique_ptr<RoutesTable<TRouter::TickWeight>> tick_routes_table = nullptr;
 
     void SerializeCatalogue(const Catalogue::TransportCatalogue& catalogue, 
                                 proto_tc::TransportCatalogue& pb_catalogue);
     void SerializeRenderSettings(proto_map_render::RenderSettings& pb_render_settings);
-    void SerializeRouter(proto_tr::TransportRouter& router);
+    void SerializeRouter(const Catalogue::TransportCatalogue& catalogue, proto_tr::TransportRouter& router);
 
 
     void DeserializeTransportRouter(const proto_tr::TransportRouter& pb_router, const Catalogue::TransportCatalogue& catalogue);
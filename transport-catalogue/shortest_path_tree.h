@@ -0,0 +1,375 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "dijkstra_router.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Weights and last edges of the shortest routes from one source to every vertex.
+// Unreachable vertices hold UNREACHABLE, the source holds NONE_EDGE.
+template <typename Weight>
+struct ShortestPathTree {
+    using CompactEdgeId = uint32_t;
+
+    static constexpr Weight UNREACHABLE = RoutesTable<Weight>::UNREACHABLE;
+    static constexpr CompactEdgeId NONE_EDGE = RoutesTable<Weight>::NONE_EDGE;
+
+    std::vector<Weight> weights;
+    std::vector<CompactEdgeId> prev_edges;
+
+    // full Dijkstra from source over a frozen graph
+    static ShortestPathTree Build(const DirectedWeightedGraph<Weight>& graph, VertexId source);
+
+    std::optional<typename RouterBase<Weight>::RouteInfo> BuildRoute(const DirectedWeightedGraph<Weight>& graph,
+                                                                     VertexId to) const;
+
+    size_t GetMemoryUsage() const {
+        return weights.capacity() * sizeof(Weight) + prev_edges.capacity() * sizeof(CompactEdgeId);
+    }
+};
+
+// Trees of the recently used sources within a memory budget in bytes, the least recently used
+// ones are evicted first. Trees are shared, so an evicted tree stays valid for whoever still holds it.
+// All methods are thread-safe.
+template <typename Weight>
+class ShortestPathTreeCache {
+public:
+    using Tree = ShortestPathTree<Weight>;
+
+    struct Statistics {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t tree_count = 0;
+        size_t memory_usage = 0;
+    };
+
+    explicit ShortestPathTreeCache(size_t memory_budget)
+        : memory_budget_(memory_budget) {
+    }
+
+    // counts a hit or a miss
+    std::shared_ptr<const Tree> Find(VertexId source);
+    // a tree larger than the whole budget is returned without being kept
+    std::shared_ptr<const Tree> Insert(VertexId source, Tree&& tree);
+
+    Statistics GetStatistics() const;
+
+private:
+    using Entry = std::pair<VertexId, std::shared_ptr<const Tree>>;
+
+    mutable std::mutex mutex_;
+    const size_t memory_budget_;
+    std::list<Entry> entries_; // most recently used first
+    std::unordered_map<VertexId, typename std::list<Entry>::iterator> source_to_entry_;
+    Statistics statistics_;
+};
+
+// Weights of the shortest routes from every source to every target, nullopt for unreachable ones.
+// One Dijkstra per source which stops as soon as all targets are settled, sources are shared
+// between thread_count threads. The graph must be frozen.
+template <typename Weight>
+std::vector<std::vector<std::optional<Weight>>> ComputeRouteWeightMatrix(const DirectedWeightedGraph<Weight>& graph,
+                                                                         const std::vector<VertexId>& sources,
+                                                                         const std::vector<VertexId>& targets,
+                                                                         size_t thread_count);
+
+// Vertices whose shortest routes from source weigh no more than max_weight, with those weights,
+// in increasing order of weight. The search doesn't expand past max_weight. The graph must be frozen.
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> ComputeReachableVertices(const DirectedWeightedGraph<Weight>& graph,
+                                                                  VertexId source, Weight max_weight);
+
+// Answers from shortest-path trees of the sources announced by PrepareSources, which are built
+// in parallel, and falls back to a point-to-point Dijkstra for any other source.
+// Nothing is precomputed for sources which are never asked. The graph must be frozen.
+template <typename Weight>
+class ShortestPathTreeRouter final : public RouterBase<Weight> {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+    using Tree = ShortestPathTree<Weight>;
+
+public:
+    using RouteInfo = typename RouterBase<Weight>::RouteInfo;
+
+    explicit ShortestPathTreeRouter(const Graph& graph);
+
+    void PrepareSources(const std::vector<VertexId>& sources, size_t thread_count) override;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+
+private:
+    const Graph& graph_;
+    DijkstraRouter<Weight> fallback_router_;
+    std::unordered_map<VertexId, Tree> trees_;
+};
+
+template <typename Weight>
+ShortestPathTree<Weight> ShortestPathTree<Weight>::Build(const DirectedWeightedGraph<Weight>& graph,
+                                                         VertexId source) {
+    using SearchData = DijkstraSearchData<Weight>;
+    static thread_local SearchData data;
+
+    const size_t vertex_count = graph.GetVertexCount();
+    if (graph.GetEdgeCount() >= NONE_EDGE) {
+        throw std::length_error("Too many edges for the shortest-path tree");
+    }
+    data.Prepare(vertex_count);
+    data.Reach(source, Weight{}, SearchData::NONE_EDGE);
+    while (!data.IsQueueEmpty()) {
+        const auto [weight, vertex] = data.Pop();
+        if (data.weights[vertex] < weight) {
+            continue; // outdated queue item
+        }
+        const auto arcs = graph.GetOutgoingArcs(vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = weight + arcs.weights[idx];
+            if (!data.IsReached(next) || candidate_weight < data.weights[next]) {
+                data.Reach(next, candidate_weight, arcs.edge_ids[idx]);
+            }
+        }
+    }
+
+    ShortestPathTree tree;
+    tree.weights.assign(vertex_count, UNREACHABLE);
+    tree.prev_edges.assign(vertex_count, NONE_EDGE);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        if (data.IsReached(vertex)) {
+            tree.weights[vertex] = data.weights[vertex];
+            if (data.prev_edges[vertex] != SearchData::NONE_EDGE) {
+                tree.prev_edges[vertex] = static_cast<CompactEdgeId>(data.prev_edges[vertex]);
+            }
+        }
+    }
+    return tree;
+}
+
+template <typename Weight>
+std::optional<typename RouterBase<Weight>::RouteInfo>
+ShortestPathTree<Weight>::BuildRoute(const DirectedWeightedGraph<Weight>& graph, VertexId to) const {
+    if (weights[to] == UNREACHABLE) {
+        return std::nullopt;
+    }
+    std::vector<EdgeId> edges;
+    for (CompactEdgeId edge_id = prev_edges[to]; edge_id != NONE_EDGE;
+         edge_id = prev_edges[graph.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return typename RouterBase<Weight>::RouteInfo{weights[to], std::move(edges)};
+}
+
+template <typename Weight>
+std::vector<std::vector<std::optional<Weight>>> ComputeRouteWeightMatrix(const DirectedWeightedGraph<Weight>& graph,
+                                                                         const std::vector<VertexId>& sources,
+                                                                         const std::vector<VertexId>& targets,
+                                                                         size_t thread_count) {
+    using SearchData = DijkstraSearchData<Weight>;
+
+    const size_t vertex_count = graph.GetVertexCount();
+    std::vector<bool> is_target(vertex_count, false);
+    size_t target_count = 0;
+    for (const VertexId vertex : targets) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of graph");
+        }
+        if (!is_target[vertex]) {
+            is_target[vertex] = true;
+            ++target_count;
+        }
+    }
+    for (const VertexId vertex : sources) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of graph");
+        }
+    }
+
+    std::vector<std::vector<std::optional<Weight>>> matrix(sources.size());
+    thread_count = std::min(parallel::GetThreadCount(thread_count), std::max<size_t>(sources.size(), 1));
+    parallel::ForEachThread(thread_count, [&](size_t thread_index) {
+        static thread_local SearchData data;
+        const auto [begin, end] = parallel::GetThreadShare(sources.size(), thread_index, thread_count);
+        for (size_t idx = begin; idx < end; ++idx) {
+            data.Prepare(vertex_count);
+            data.Reach(sources[idx], Weight{}, SearchData::NONE_EDGE);
+            size_t settled_target_count = 0;
+            while (!data.IsQueueEmpty() && settled_target_count < target_count) {
+                const auto [weight, vertex] = data.Pop();
+                if (data.weights[vertex] < weight) {
+                    continue; // outdated queue item
+                }
+                if (is_target[vertex]) {
+                    ++settled_target_count;
+                }
+                const auto arcs = graph.GetOutgoingArcs(vertex);
+                for (size_t arc = 0; arc < arcs.size; ++arc) {
+                    const VertexId next = arcs.vertices[arc];
+                    const Weight candidate_weight = weight + arcs.weights[arc];
+                    if (!data.IsReached(next) || candidate_weight < data.weights[next]) {
+                        data.Reach(next, candidate_weight, arcs.edge_ids[arc]);
+                    }
+                }
+            }
+
+            auto& row = matrix[idx];
+            row.reserve(targets.size());
+            for (const VertexId target : targets) {
+                row.push_back(data.IsReached(target) ? std::optional<Weight>(data.weights[target]) : std::nullopt);
+            }
+        }
+    });
+    return matrix;
+}
+
+template <typename Weight>
+std::vector<std::pair<VertexId, Weight>> ComputeReachableVertices(const DirectedWeightedGraph<Weight>& graph,
+                                                                  VertexId source, Weight max_weight) {
+    using SearchData = DijkstraSearchData<Weight>;
+    static thread_local SearchData data;
+
+    if (source >= graph.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+    std::vector<std::pair<VertexId, Weight>> reachable;
+    if (max_weight < Weight{}) {
+        return reachable;
+    }
+    data.Prepare(graph.GetVertexCount());
+    data.Reach(source, Weight{}, SearchData::NONE_EDGE);
+    while (!data.IsQueueEmpty()) {
+        const auto [weight, vertex] = data.Pop();
+        if (data.weights[vertex] < weight) {
+            continue; // outdated queue item
+        }
+        reachable.emplace_back(vertex, weight);
+        const auto arcs = graph.GetOutgoingArcs(vertex);
+        for (size_t idx = 0; idx < arcs.size; ++idx) {
+            const VertexId next = arcs.vertices[idx];
+            const Weight candidate_weight = weight + arcs.weights[idx];
+            if (max_weight < candidate_weight) {
+                continue;
+            }
+            if (!data.IsReached(next) || candidate_weight < data.weights[next]) {
+                data.Reach(next, candidate_weight, arcs.edge_ids[idx]);
+            }
+        }
+    }
+    return reachable;
+}
+
+template <typename Weight>
+std::shared_ptr<const typename ShortestPathTreeCache<Weight>::Tree> ShortestPathTreeCache<Weight>::Find(VertexId source) {
+    std::lock_guard guard(mutex_);
+    const auto entry = source_to_entry_.find(source);
+    if (entry == source_to_entry_.end()) {
+        ++statistics_.misses;
+        return nullptr;
+    }
+    ++statistics_.hits;
+    entries_.splice(entries_.begin(), entries_, entry->second);
+    return entry->second->second;
+}
+
+template <typename Weight>
+std::shared_ptr<const typename ShortestPathTreeCache<Weight>::Tree> ShortestPathTreeCache<Weight>::Insert(VertexId source,
+                                                                                                           Tree&& tree) {
+    auto tree_ptr = std::make_shared<const Tree>(std::move(tree));
+    const size_t tree_memory = tree_ptr->GetMemoryUsage();
+
+    std::lock_guard guard(mutex_);
+    if (const auto entry = source_to_entry_.find(source); entry != source_to_entry_.end()) {
+        // built meanwhile by another thread
+        entries_.splice(entries_.begin(), entries_, entry->second);
+        return entry->second->second;
+    }
+    if (tree_memory > memory_budget_) {
+        return tree_ptr;
+    }
+    while (statistics_.memory_usage + tree_memory > memory_budget_) {
+        const Entry& oldest = entries_.back();
+        statistics_.memory_usage -= oldest.second->GetMemoryUsage();
+        source_to_entry_.erase(oldest.first);
+        entries_.pop_back();
+        ++statistics_.evictions;
+    }
+    entries_.emplace_front(source, tree_ptr);
+    source_to_entry_[source] = entries_.begin();
+    statistics_.memory_usage += tree_memory;
+    statistics_.tree_count = entries_.size();
+    return tree_ptr;
+}
+
+template <typename Weight>
+typename ShortestPathTreeCache<Weight>::Statistics ShortestPathTreeCache<Weight>::GetStatistics() const {
+    std::lock_guard guard(mutex_);
+    Statistics statistics = statistics_;
+    statistics.tree_count = entries_.size();
+    return statistics;
+}
+
+template <typename Weight>
+ShortestPathTreeRouter<Weight>::ShortestPathTreeRouter(const Graph& graph)
+    : graph_(graph)
+    , fallback_router_(graph)
+{
+}
+
+template <typename Weight>
+void ShortestPathTreeRouter<Weight>::PrepareSources(const std::vector<VertexId>& sources, size_t thread_count) {
+    std::vector<VertexId> new_sources;
+    for (const VertexId source : sources) {
+        if (source >= graph_.GetVertexCount()) {
+            throw std::out_of_range("Vertex id is out of graph");
+        }
+        if (trees_.count(source) == 0) {
+            new_sources.push_back(source);
+        }
+    }
+    std::sort(new_sources.begin(), new_sources.end());
+    new_sources.erase(std::unique(new_sources.begin(), new_sources.end()), new_sources.end());
+
+    std::vector<Tree> new_trees(new_sources.size());
+    thread_count = std::min(parallel::GetThreadCount(thread_count), std::max<size_t>(new_sources.size(), 1));
+    parallel::ForEachThread(thread_count, [&](size_t thread_index) {
+        const auto [begin, end] = parallel::GetThreadShare(new_sources.size(), thread_index, thread_count);
+        for (size_t idx = begin; idx < end; ++idx) {
+            new_trees[idx] = Tree::Build(graph_, new_sources[idx]);
+        }
+    });
+
+    for (size_t idx = 0; idx < new_sources.size(); ++idx) {
+        trees_.emplace(new_sources[idx], std::move(new_trees[idx]));
+    }
+}
+
+template <typename Weight>
+std::optional<typename ShortestPathTreeRouter<Weight>::RouteInfo>
+ShortestPathTreeRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of graph");
+    }
+    if (const auto tree = trees_.find(from); tree != trees_.end()) {
+        return tree->second.BuildRoute(graph_, to);
+    }
+    return fallback_router_.BuildRoute(from, to);
+}
+
+}  // namespace graph
@@ -0,0 +1,168 @@
+#define _USE_MATH_DEFINES
+
+#include "stop_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace Catalogue {
+
+namespace {
+
+const double DR = M_PI / 180.;
+const double EARTH_RADIUS = 6371000.;
+
+} // namespace
+
+StopIndex::StopIndex(const std::deque<Stop>& stops) {
+    nodes_.reserve(stops.size());
+    for (const auto& stop : stops) {
+        nodes_.push_back({ ToPoint(stop.coordinates), &stop, 0 });
+    }
+    Build(0, nodes_.size());
+}
+
+StopIndex::Point StopIndex::ToPoint(geo::Coordinates coordinates) {
+    const double lat = coordinates.lat * DR;
+    const double lng = coordinates.lng * DR;
+    return { std::cos(lat) * std::cos(lng), std::cos(lat) * std::sin(lng), std::sin(lat) };
+}
+
+double StopIndex::GetSquaredDistance(const Point& lhs, const Point& rhs) {
+    const double dx = lhs[0] - rhs[0];
+    const double dy = lhs[1] - rhs[1];
+    const double dz = lhs[2] - rhs[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+void StopIndex::Build(size_t begin, size_t end) {
+    if (end - begin < 2) {
+        return;
+    }
+    // the subrange is split by the coordinate it spreads most along
+    Point min_point = nodes_[begin].point;
+    Point max_point = nodes_[begin].point;
+    for (size_t idx = begin + 1; idx < end; ++idx) {
+        for (size_t axis = 0; axis < 3; ++axis) {
+            min_point[axis] = std::min(min_point[axis], nodes_[idx].point[axis]);
+            max_point[axis] = std::max(max_point[axis], nodes_[idx].point[axis]);
+        }
+    }
+    uint8_t split_axis = 0;
+    for (uint8_t axis = 1; axis < 3; ++axis) {
+        if (max_point[axis] - min_point[axis] > max_point[split_axis] - min_point[split_axis]) {
+            split_axis = axis;
+        }
+    }
+
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(nodes_.begin() + begin, nodes_.begin() + middle, nodes_.begin() + end,
+        [split_axis](const Node& lhs, const Node& rhs) {
+            return lhs.point[split_axis] < rhs.point[split_axis];
+        });
+    nodes_[middle].axis = split_axis;
+    Build(begin, middle);
+    Build(middle + 1, end);
+}
+
+void StopIndex::FindNearest(const Point& point, size_t count, size_t begin, size_t end,
+    std::vector<Candidate>& heap) const
+{
+    if (begin >= end) {
+        return;
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    const Node& node = nodes_[middle];
+
+    // heap holds the closest nodes met so far, the farthest of them on top
+    const Candidate candidate{ GetSquaredDistance(point, node.point), node.stop->id, middle };
+    if (heap.size() < count || candidate < heap.front()) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end());
+        if (heap.size() > count) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+    }
+
+    // the side of the split the point is on goes first, the other one only if it may hold a closer node
+    // or an equally distant one with a lower stop id
+    const double split_distance = point[node.axis] - node.point[node.axis];
+    const bool is_lower = split_distance < 0;
+    FindNearest(point, count, is_lower ? begin : middle + 1, is_lower ? middle : end, heap);
+    if (heap.size() < count || split_distance * split_distance <= heap.front().squared_distance) {
+        FindNearest(point, count, is_lower ? middle + 1 : begin, is_lower ? end : middle, heap);
+    }
+}
+
+void StopIndex::FindWithin(const Point& point, double squared_radius, size_t begin, size_t end,
+    std::vector<size_t>& found) const
+{
+    if (begin >= end) {
+        return;
+    }
+    const size_t middle = begin + (end - begin) / 2;
+    const Node& node = nodes_[middle];
+
+    if (GetSquaredDistance(point, node.point) <= squared_radius) {
+        found.push_back(middle);
+    }
+    const double split_distance = point[node.axis] - node.point[node.axis];
+    if (split_distance <= 0 || split_distance * split_distance <= squared_radius) {
+        FindWithin(point, squared_radius, begin, middle, found);
+    }
+    if (split_distance >= 0 || split_distance * split_distance <= squared_radius) {
+        FindWithin(point, squared_radius, middle + 1, end, found);
+    }
+}
+
+std::vector<StopIndex::StopDistance> StopIndex::FindNearest(geo::Coordinates point, size_t count) const {
+    const Point query_point = ToPoint(point);
+    std::vector<Candidate> heap;
+    if (count > 0) {
+        heap.reserve(count + 1);
+        FindNearest(query_point, count, 0, nodes_.size(), heap);
+    }
+    std::vector<size_t> node_ids;
+    node_ids.reserve(heap.size());
+    for (const Candidate& candidate : heap) {
+        node_ids.push_back(candidate.node_id);
+    }
+    return ToStopDistances(query_point, node_ids);
+}
+
+std::vector<StopIndex::StopDistance> StopIndex::FindWithin(geo::Coordinates point, double radius) const {
+    const Point query_point = ToPoint(point);
+    std::vector<size_t> node_ids;
+    if (radius >= 0) {
+        // a great-circle distance of radius is a chord of 2 sin(radius / 2R) on the unit sphere; the chord
+        // is taken a bit longer, so the stops on the boundary are kept by the check below
+        const double chord = 2 * std::sin(std::min(radius / EARTH_RADIUS, M_PI) / 2) * (1 + 1e-9);
+        FindWithin(query_point, chord * chord, 0, nodes_.size(), node_ids);
+    }
+    auto stops = ToStopDistances(query_point, node_ids);
+    stops.erase(std::remove_if(stops.begin(), stops.end(), [radius](const StopDistance& stop) {
+        return stop.second > radius;
+    }), stops.end());
+    return stops;
+}
+
+std::vector<StopIndex::StopDistance> StopIndex::ToStopDistances(const Point& point,
+    const std::vector<size_t>& node_ids) const
+{
+    std::vector<StopDistance> stops;
+    stops.reserve(node_ids.size());
+    for (const size_t node_id : node_ids) {
+        const double chord = std::sqrt(GetSquaredDistance(point, nodes_[node_id].point));
+        stops.emplace_back(nodes_[node_id].stop, 2 * std::asin(std::min(chord / 2, 1.)) * EARTH_RADIUS);
+    }
+    // equally distant stops go by id, as FindNearest picks them
+    std::sort(stops.begin(), stops.end(), [](const StopDistance& lhs, const StopDistance& rhs) {
+        return std::make_pair(lhs.second, lhs.first->id) < std::make_pair(rhs.second, rhs.first->id);
+    });
+    return stops;
+}
+
+} // namespace Catalogue
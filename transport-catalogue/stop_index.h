@@ -0,0 +1,69 @@
+#pragma once
+
+#include "geo.h"
+#include "domain.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Catalogue {
+
+using namespace domain;
+
+// Static k-d tree over the stop coordinates, built once. Stops are placed on the unit sphere, where
+// the straight-line distance between points grows with the great-circle one, so the tree splits and
+// prunes on plain 3D coordinates; distances are great-circle ones on the sphere of geo::ComputeDistance,
+// taken from the chord, which stays accurate for close stops. The tree lives in one array:
+// the node of a subrange is in its middle, with the nodes of its lower and upper halves before and after.
+class StopIndex {
+public:
+    using StopDistance = std::pair<const Stop*, double>; // a stop and its distance from the point in meters
+
+    explicit StopIndex(const std::deque<Stop>& stops);
+
+    // count stops closest to the point, nearest first
+    std::vector<StopDistance> FindNearest(geo::Coordinates point, size_t count) const;
+
+    // stops no farther than radius meters from the point, nearest first
+    std::vector<StopDistance> FindWithin(geo::Coordinates point, double radius) const;
+
+private:
+    using Point = std::array<double, 3>;
+
+    struct Node {
+        Point point;
+        const Stop* stop = nullptr;
+        uint8_t axis = 0; // coordinate the subrange is split by
+    };
+
+    // node met by the nearest search; equally distant nodes go by stop id, so the stops kept don't depend
+    // on the tree shape
+    struct Candidate {
+        double squared_distance = 0;
+        uint32_t stop_id = 0;
+        size_t node_id = 0;
+
+        bool operator<(const Candidate& other) const {
+            return std::tie(squared_distance, stop_id) < std::tie(other.squared_distance, other.stop_id);
+        }
+    };
+
+    static Point ToPoint(geo::Coordinates coordinates);
+    static double GetSquaredDistance(const Point& lhs, const Point& rhs);
+
+    void Build(size_t begin, size_t end);
+    void FindNearest(const Point& point, size_t count, size_t begin, size_t end,
+        std::vector<Candidate>& heap) const;
+    void FindWithin(const Point& point, double squared_radius, size_t begin, size_t end,
+        std::vector<size_t>& found) const;
+
+    std::vector<StopDistance> ToStopDistances(const Point& point, const std::vector<size_t>& node_ids) const;
+
+    std::vector<Node> nodes_;
+};
+
+} // namespace Catalogue
@@ -0,0 +1,208 @@
+#include "timetable_router.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace TRouter {
+
+TimetableRouter::TimetableRouter(const TransportCatalogue& catalogue)
+	: catalogue_(catalogue)
+{
+	stops_.resize(catalogue.GetStopCount(), nullptr);
+	for (const auto& stop : catalogue.GetStops()) {
+		stops_[stop.id] = &stop;
+	}
+
+	route_stop_offsets_.push_back(0);
+	for (const auto& bus : catalogue.GetBuses()) {
+		if (bus.trips_.empty()) {
+			continue;
+		}
+		routes_.push_back(&bus);
+		for (const Stop* stop : bus.route_) {
+			route_stops_.push_back(stop->id);
+		}
+		route_stop_offsets_.push_back(static_cast<uint32_t>(route_stops_.size()));
+		route_trip_counts_.push_back(static_cast<uint32_t>(bus.trips_.size()));
+		route_departure_offsets_.push_back(departures_.size());
+		for (const Trip& trip : bus.trips_) {
+			departures_.insert(departures_.end(), trip.begin(), trip.end());
+		}
+	}
+
+	// every occurrence of a stop on a route, grouped by stop
+	stop_route_offsets_.assign(stops_.size() + 1, 0);
+	for (const uint32_t stop_id : route_stops_) {
+		++stop_route_offsets_[stop_id + 1];
+	}
+	std::partial_sum(stop_route_offsets_.begin(), stop_route_offsets_.end(), stop_route_offsets_.begin());
+	stop_routes_.resize(route_stops_.size());
+	std::vector<uint32_t> positions(stop_route_offsets_.begin(), stop_route_offsets_.end() - 1);
+	for (uint32_t route = 0; route < routes_.size(); ++route) {
+		for (uint32_t position = 0; position < GetStopCount(route); ++position) {
+			const uint32_t stop_id = route_stops_[route_stop_offsets_[route] + position];
+			stop_routes_[positions[stop_id]++] = { route, position };
+		}
+	}
+}
+
+uint32_t TimetableRouter::FindTrip(uint32_t route, uint32_t position, double time, uint32_t last_trip) const {
+	// trips keep their order at every stop, so departures from a stop grow with the trip
+	uint32_t first = 0;
+	uint32_t last = last_trip;
+	while (first < last) {
+		const uint32_t middle = first + (last - first) / 2;
+		if (GetDeparture(route, middle, position) < time) {
+			first = middle + 1;
+		} else {
+			last = middle;
+		}
+	}
+	return first;
+}
+
+std::optional<TimedRouteInfo> TimetableRouter::GetTimedRouteInfo(std::string_view from, std::string_view to,
+	double departure_time) const
+{
+	if (!catalogue_.CheckStop(from) || !catalogue_.CheckStop(to)) {
+		return std::nullopt;
+	}
+	const uint32_t source = catalogue_.FindStop(from)->id;
+	const uint32_t target = catalogue_.FindStop(to)->id;
+	if (source == target) {
+		return TimedRouteInfo{ departure_time, departure_time, 0, {} };
+	}
+
+	const size_t stop_count = stops_.size();
+	SearchData& data = GetSearchData();
+	data.best_arrivals.assign(stop_count, NEVER);
+	data.labels.clear();
+	data.last_labels.assign(stop_count, NONE);
+	data.ready_times.resize(stop_count);
+	data.boarding_rounds.assign(stop_count, NONE);
+	data.is_marked.assign(stop_count, false);
+	data.marked_stops.clear();
+	data.route_positions.assign(routes_.size(), NONE);
+	data.queued_routes.clear();
+
+	data.best_arrivals[source] = departure_time;
+	data.is_marked[source] = true;
+	data.marked_stops.push_back(source);
+
+	for (uint32_t round = 1; !data.marked_stops.empty(); ++round) {
+		// the stops improved by the previous round are boarded from, with their arrivals as they are now;
+		// every route through them is scanned once, from the first of them on it
+		for (const uint32_t stop_id : data.marked_stops) {
+			data.is_marked[stop_id] = false;
+			data.ready_times[stop_id] = data.best_arrivals[stop_id];
+			data.boarding_rounds[stop_id] = round;
+			for (uint32_t idx = stop_route_offsets_[stop_id]; idx < stop_route_offsets_[stop_id + 1]; ++idx) {
+				const auto [route, position] = stop_routes_[idx];
+				if (data.route_positions[route] == NONE) {
+					data.queued_routes.push_back(route);
+					data.route_positions[route] = position;
+				} else {
+					data.route_positions[route] = std::min(data.route_positions[route], position);
+				}
+			}
+		}
+		data.marked_stops.clear();
+
+		for (const uint32_t route : data.queued_routes) {
+			// departures are read through local pointers: stores to the arrivals may alias the members
+			const uint32_t* route_stops = route_stops_.data() + route_stop_offsets_[route];
+			const uint32_t route_stop_count = GetStopCount(route);
+			const double* route_departures = departures_.data() + route_departure_offsets_[route];
+			uint32_t trip = NONE;
+			const double* trip_departures = nullptr;
+			uint32_t board_position = 0;
+			for (uint32_t position = data.route_positions[route]; position < route_stop_count; ++position) {
+				const uint32_t stop_id = route_stops[position];
+				if (trip != NONE) {
+					const double arrival = trip_departures[position];
+					// a stop later than the best arrival at the target can't lead to a better route
+					if (arrival < std::min(data.best_arrivals[stop_id], data.best_arrivals[target])) {
+						data.best_arrivals[stop_id] = arrival;
+						data.labels.push_back({ round, route, trip, board_position, position, data.last_labels[stop_id] });
+						data.last_labels[stop_id] = static_cast<uint32_t>(data.labels.size() - 1);
+						if (!data.is_marked[stop_id]) {
+							data.is_marked[stop_id] = true;
+							data.marked_stops.push_back(stop_id);
+						}
+					}
+				}
+				// an earlier trip may be caught here by the arrival of the previous round; an arrival improved
+				// before it has already been ridden on from in an earlier round
+				if (data.boarding_rounds[stop_id] != round) {
+					continue;
+				}
+				const double ready_time = data.ready_times[stop_id];
+				if (!(ready_time < data.best_arrivals[target])) {
+					continue;
+				}
+				// there is an earlier trip to catch only if the current trip can be caught, which is cheap to check
+				// as its departures are being read, and the one just before it can be caught as well
+				if (trip != NONE && ready_time > trip_departures[position]) {
+					continue;
+				}
+				const uint32_t trip_end = trip == NONE ? route_trip_counts_[route] : trip;
+				if (trip_end > 0 && ready_time <= route_departures[static_cast<size_t>(trip_end - 1) * route_stop_count + position]) {
+					trip = FindTrip(route, position, ready_time, trip_end - 1);
+					trip_departures = route_departures + static_cast<size_t>(trip) * route_stop_count;
+					board_position = position;
+				}
+			}
+			data.route_positions[route] = NONE;
+		}
+		data.queued_routes.clear();
+	}
+
+	if (data.best_arrivals[target] == NEVER) {
+		return std::nullopt;
+	}
+
+	// arrivals only get strictly earlier, so the last label of the target is from the round with the fewest
+	// trips among the earliest routes; the route is walked back ride by ride, a ride is boarded by the arrival
+	// of the last label of its stop from an earlier round
+	TimedRouteInfo route_info{ departure_time, data.best_arrivals[target], 0, {} };
+	uint32_t label_idx = data.last_labels[target];
+	while (label_idx != NONE) {
+		const Label& label = data.labels[label_idx];
+		const uint32_t board_stop = route_stops_[route_stop_offsets_[label.route] + label.board_position];
+		const double board_time = GetDeparture(label.route, label.trip, label.board_position);
+		const double alight_time = GetDeparture(label.route, label.trip, label.alight_position);
+
+		uint32_t board_label_idx = data.last_labels[board_stop];
+		while (board_label_idx != NONE && data.labels[board_label_idx].round >= label.round) {
+			board_label_idx = data.labels[board_label_idx].previous;
+		}
+		double ready_time = departure_time;
+		if (board_label_idx != NONE) {
+			const Label& board_label = data.labels[board_label_idx];
+			ready_time = GetDeparture(board_label.route, board_label.trip, board_label.alight_position);
+		}
+
+		RouteItem ride;
+		ride.type = RouteReqestType::BUS;
+		ride.time = alight_time - board_time;
+		ride.bus_name = routes_[label.route]->name_;
+		ride.span_count = label.alight_position - label.board_position;
+		route_info.items.push_back(std::move(ride));
+
+		RouteItem wait;
+		wait.type = RouteReqestType::WAIT;
+		wait.time = board_time - ready_time;
+		wait.stop_name = stops_[board_stop]->name_;
+		route_info.items.push_back(std::move(wait));
+
+		label_idx = board_label_idx;
+	}
+	std::reverse(route_info.items.begin(), route_info.items.end());
+	route_info.transfers = route_info.items.size() / 2 - 1;
+
+	return route_info;
+}
+
+} // namespace TRouter
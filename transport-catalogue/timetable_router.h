@@ -0,0 +1,99 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+#include "domain.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace TRouter {
+
+using namespace Catalogue;
+using namespace domain;
+
+struct TimedRouteInfo {
+	double departure_time = .0;
+	double arrival_time = .0;
+	size_t transfers = 0;
+	std::vector<RouteItem> items; // a wait for every trip at the stop it's boarded from, then the ride
+};
+
+// RAPTOR over the bus timetables. Round k scans every bus through a stop whose arrival was improved
+// in round k - 1, riding the earliest trip which can be caught at each of its stops, so after round k
+// a stop holds its earliest arrival with at most k trips. The search ends when a round improves nothing.
+// Routes, trips and the buses through a stop are kept in flat arrays, so a round walks memory in order.
+// A trip arrives at a stop when it departs from it, and a transfer takes no time.
+class TimetableRouter {
+public:
+	explicit TimetableRouter(const TransportCatalogue& catalogue);
+
+	// earliest arrival at to leaving from at departure_time, with the fewest transfers among the routes
+	// arriving then; nullopt when a stop is unknown or to can't be reached by the timetables
+	std::optional<TimedRouteInfo> GetTimedRouteInfo(std::string_view from, std::string_view to,
+		double departure_time) const;
+
+private:
+	static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+	static constexpr double NEVER = std::numeric_limits<double>::infinity();
+
+	// an improvement of the arrival at a stop: the ride which brings there in the round
+	struct Label {
+		uint32_t round = 0;
+		uint32_t route = 0;
+		uint32_t trip = 0;
+		uint32_t board_position = 0;
+		uint32_t alight_position = 0;
+		uint32_t previous = NONE; // earlier label of the same stop
+	};
+
+	// per-thread buffers; a round touches only the stops it improves and the ones it boards from,
+	// however many stops there are
+	struct SearchData {
+		std::vector<double> best_arrivals; // by stop, over all the rounds so far
+		std::vector<Label> labels; // in order they're made
+		std::vector<uint32_t> last_labels; // by stop, NONE until it's improved
+		std::vector<double> ready_times; // by stop, its arrival when a round boarding from it starts
+		std::vector<uint32_t> boarding_rounds; // by stop, the last round boarding from it
+		std::vector<uint32_t> marked_stops;
+		std::vector<bool> is_marked;
+		std::vector<uint32_t> route_positions; // by route, where its scan starts, NONE when it isn't queued
+		std::vector<uint32_t> queued_routes;
+	};
+
+	static SearchData& GetSearchData() {
+		static thread_local SearchData search_data;
+		return search_data;
+	}
+
+	double GetDeparture(uint32_t route, uint32_t trip, uint32_t position) const {
+		return departures_[route_departure_offsets_[route] + static_cast<size_t>(trip) * GetStopCount(route) + position];
+	}
+
+	uint32_t GetStopCount(uint32_t route) const {
+		return route_stop_offsets_[route + 1] - route_stop_offsets_[route];
+	}
+
+	// the first trip of the route leaving the stop at position no earlier than time, among the trips
+	// up to last_trip, which is known to leave no earlier
+	uint32_t FindTrip(uint32_t route, uint32_t position, double time, uint32_t last_trip) const;
+
+	const TransportCatalogue& catalogue_;
+	std::vector<const Stop*> stops_; // by stop id
+
+	std::vector<const Bus*> routes_; // buses having a timetable
+	std::vector<uint32_t> route_stop_offsets_; // stops of route r are route_stops_[offsets[r], offsets[r + 1])
+	std::vector<uint32_t> route_stops_; // stop ids
+	std::vector<uint32_t> route_trip_counts_;
+	std::vector<size_t> route_departure_offsets_; // departures of route r start there, trip after trip
+	std::vector<double> departures_;
+
+	std::vector<uint32_t> stop_route_offsets_; // routes through stop s are stop_routes_[offsets[s], offsets[s + 1])
+	std::vector<std::pair<uint32_t, uint32_t>> stop_routes_; // route and a position of the stop in it
+};
+
+} // namespace TRouter
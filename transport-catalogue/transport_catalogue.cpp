@@ -8,6 +8,7 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <stdexcept>
 
 #include <iostream>
 
@@ -15,7 +16,7 @@ namespace Catalogue {
 
 void TransportCatalogue::AddStop(const std::string& name, double lat, double lng)
 {
-    stops_.push_back(Stop { name, lat, lng });
+    stops_.push_back(Stop { static_cast<uint32_t>(stops_.size()), name, lat, lng });
     stopname_to_stop_.insert({ stops_.back().name_, &stops_.back() });
 }
 
@@ -50,6 +51,7 @@ void TransportCatalogue::AddBus(const std::string& name, const std::vector<const
     size_t unique_size = unique.size();
 
     buses_.push_back(Bus { name, route, unique_size, length, geo_length, is_roundtrip, last_stop});
+    ComputeRouteDistances(buses_.back());
     busname_to_bus_.insert({ buses_.back().name_, &buses_.back() });
     
     std::string_view busname = buses_.back().name_;
@@ -62,6 +64,7 @@ void TransportCatalogue::AddBus(const std::string& name, const std::vector<const
 void TransportCatalogue::AddBus(Bus&& bus)
 {
     buses_.push_back(std::move(bus));
+    ComputeRouteDistances(buses_.back());
     busname_to_bus_.insert({ buses_.back().name_, &buses_.back() });
     
     std::string_view busname = buses_.back().name_;
@@ -76,6 +79,42 @@ const Bus* TransportCatalogue::FindBus(std::string_view name) const
     return busname_to_bus_.at(name);
 }
 
+Bus& TransportCatalogue::FindMutableBus(std::string_view name)
+{
+    const auto it = std::find_if(buses_.begin(), buses_.end(), [name](const Bus& bus) {
+        return bus.name_ == name;
+    });
+    if (it == buses_.end()) {
+        throw std::out_of_range("Unknown bus " + std::string(name));
+    }
+    return *it;
+}
+
+void TransportCatalogue::SetBusTrips(std::string_view name, std::vector<Trip>&& trips)
+{
+    Bus& bus = FindMutableBus(name);
+    for (const Trip& trip : trips) {
+        if (trip.size() != bus.route_.size()) {
+            throw std::invalid_argument("Trip of bus " + bus.name_ + " should have a departure for every stop of the route");
+        }
+        if (!std::is_sorted(trip.begin(), trip.end())) {
+            throw std::invalid_argument("Trip of bus " + bus.name_ + " goes back in time");
+        }
+    }
+    std::stable_sort(trips.begin(), trips.end(), [](const Trip& lhs, const Trip& rhs) {
+        return lhs.front() < rhs.front();
+    });
+    // timetable searches take the first trip leaving a stop after some time, so trips keep their order at every stop
+    for (size_t idx = 1; idx < trips.size(); ++idx) {
+        for (size_t pos = 0; pos < bus.route_.size(); ++pos) {
+            if (trips[idx][pos] < trips[idx - 1][pos]) {
+                throw std::invalid_argument("Trips of bus " + bus.name_ + " overtake each other");
+            }
+        }
+    }
+    bus.trips_ = std::move(trips);
+}
+
 const std::unordered_map<std::string_view, const Bus*>& TransportCatalogue::GetBusNameToBus() const {
     return busname_to_bus_;
 }
@@ -123,7 +162,18 @@ const std::set<std::string_view>& TransportCatalogue::GetBusesInStop(std::string
 
 void TransportCatalogue::AddDistance(std::string_view stop_x, std::string_view stop_y, int64_t distance)
 {
-    dist_btn_stops_[{ FindStop(stop_x), FindStop(stop_y) }] = distance;
+    const Stop* from = FindStop(stop_x);
+    const Stop* to = FindStop(stop_y);
+    dist_btn_stops_[{ from, to }] = distance;
+
+    // buses added earlier through these stops recount their route distances
+    if (stop_to_buses_.count(from) > 0 && stop_to_buses_.count(to) > 0) {
+        for (const auto& busname : stop_to_buses_.at(from)) {
+            if (stop_to_buses_.at(to).count(busname) > 0) {
+                ComputeRouteDistances(FindMutableBus(busname));
+            }
+        }
+    }
 }
 
 int64_t TransportCatalogue::GetDistance(const Stop* from, const Stop* to) const
@@ -137,23 +187,24 @@ const std::unordered_map<std::pair<const Stop*, const Stop*>, int64_t, HacherPai
 }
 
 int64_t TransportCatalogue::GetDistance(const Bus* bus, size_t start, size_t count) const {
+    const auto& distances = bus->route_distances_;
+    if (start >= distances.size()) {
+        return 0;
+    }
+    const size_t end = std::min(start + count, distances.size() - 1);
+    return distances[end] - distances[start];
+}
 
-    int64_t result = 0;
-    const auto& route = bus->route_;
-
-    auto end = start + count < bus->route_.size() ? route.begin() + start + count + 1 : route.end();
-    auto prev = route.begin() + start;
-
-    for (auto stop = route.begin() + start + 1; stop != end; ++stop) {
-
-        int64_t dst = GetDistance(*prev, *stop);
-        if (dst == 0 && bus->is_roundtrip_) {
-            dst = GetDistance(*stop, *prev);
+void TransportCatalogue::ComputeRouteDistances(Bus& bus) const {
+    const auto& route = bus.route_;
+    bus.route_distances_.assign(route.size(), 0);
+    for (size_t idx = 1; idx < route.size(); ++idx) {
+        int64_t dst = GetDistance(route[idx - 1], route[idx]);
+        if (dst == 0 && bus.is_roundtrip_) {
+            dst = GetDistance(route[idx], route[idx - 1]);
         }
-        result += dst;
-        prev = stop;
+        bus.route_distances_[idx] = bus.route_distances_[idx - 1] + dst;
     }
-    return result;
 }
 
 } // namespace TransportCatalogue
\ No newline at end of file
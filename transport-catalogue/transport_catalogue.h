@@ -26,6 +26,9 @@ public:
         int64_t length, double geo_length, bool is_roundtrip, const Stop* last_stop);
     void AddBus(Bus&& bus);
     const Bus* FindBus(std::string_view name) const;
+    // sets the timetable of the bus, sorted by departure from the first stop; throws std::invalid_argument
+    // if a trip doesn't match the route, goes back in time or overtakes another trip
+    void SetBusTrips(std::string_view name, std::vector<Trip>&& trips);
     const BusInfo GetBusInfo(std::string_view name) const;
     bool CheckStop(std::string_view name) const;
     const std::set<std::string_view>& GetBusesInStop(std::string_view stopname) const;
@@ -51,6 +54,10 @@ private:
     std::unordered_map<const Stop*, std::set<std::string_view>> stop_to_buses_; 
     // расстояние между двумя остановками
     std::unordered_map<std::pair<const Stop*, const Stop*>, int64_t, HacherPair> dist_btn_stops_;
+
+    // the bus as stored in buses_, throws std::out_of_range for an unknown name
+    Bus& FindMutableBus(std::string_view name);
+    void ComputeRouteDistances(Bus& bus) const;
 };
 
 } // namespace Catalogue
\ No newline at end of file
@@ -3,24 +3,248 @@
 #include "graph.h"
 #include "router.h"
 
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace TRouter {
 
+namespace {
+
+constexpr double KMH_TO_METERS_PER_MINUTE = 1'000. / 60;
+
+} // namespace
+
+StopDistancePotential::StopDistancePotential(std::vector<geo::Coordinates>&& vertex_coordinates,
+	std::vector<bool>&& stop_vertices, const DirectedWeightedGraph<double>& graph, const Edge_BusSpan& edge_to_bus_span,
+	const RoutingSettings& routing_settings)
+	: vertex_coordinates_(std::move(vertex_coordinates)),
+	stop_vertices_(std::move(stop_vertices)),
+	bus_wait_time_(routing_settings.transfer_radius_ > 0 ? .0 : routing_settings.bus_wait_time_)
+{
+	std::optional<double> min_ratio;
+	for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+		const auto& edge = graph.GetEdge(edge_id);
+		const double distance = geo::ComputeDistance(vertex_coordinates_[edge.from], vertex_coordinates_[edge.to]);
+		if (distance > .0) {
+			// only a ride between two stops includes the wait, a walk has no bus
+			const double ride_time = stop_vertices_[edge.from] && stop_vertices_[edge.to] && edge_to_bus_span[edge_id].first != nullptr
+				? edge.weight - routing_settings.bus_wait_time_ : edge.weight;
+			const double ratio = ride_time / distance;
+			min_ratio = min_ratio ? std::min(*min_ratio, ratio) : ratio;
+		}
+	}
+	minutes_per_meter_ = min_ratio ? std::max(*min_ratio, .0) : .0;
+}
+
+double StopDistancePotential::operator()(VertexId vertex, VertexId to) const {
+	if (vertex == to) {
+		return .0;
+	}
+	return (stop_vertices_[vertex] ? bus_wait_time_ : .0) + geo::ComputeDistance(vertex_coordinates_[vertex], vertex_coordinates_[to]) * minutes_per_meter_;
+}
+
+TickGraph MakeTickGraph(const DirectedWeightedGraph<double>& graph, size_t ticks_per_minute) {
+	TickGraph tick_graph(graph.GetVertexCount());
+	TickWeight max_weight = 0;
+	for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+		const auto& edge = graph.GetEdge(edge_id);
+		const double ticks = std::round(edge.weight * ticks_per_minute);
+		if (!(ticks < std::numeric_limits<TickWeight>::max())) {
+			throw std::domain_error("Edge weight doesn't fit in ticks, use less ticks per minute");
+		}
+		const TickWeight weight = static_cast<TickWeight>(ticks);
+		max_weight = std::max(max_weight, weight);
+		tick_graph.AddEdge({ edge.from, edge.to, weight });
+	}
+	// a sum of two route weights, each of them below vertex count heaviest edges, has to fit
+	if (static_cast<double>(max_weight) * graph.GetVertexCount() * 2 >= std::numeric_limits<TickWeight>::max()) {
+		throw std::domain_error("Route weights may overflow ticks, use less ticks per minute");
+	}
+	tick_graph.Freeze();
+	return tick_graph;
+}
+
+TickWeightRouter::TickWeightRouter(const DirectedWeightedGraph<double>& graph, std::unique_ptr<TickGraph>&& tick_graph,
+	std::unique_ptr<RouterBase<TickWeight>>&& router)
+	: graph_(graph),
+	tick_graph_(std::move(tick_graph)),
+	router_(std::move(router))
+{
+}
+
+std::optional<TickWeightRouter::RouteInfo> TickWeightRouter::BuildRoute(VertexId from, VertexId to) const {
+	auto route_info = (*router_).BuildRoute(from, to);
+	if (!route_info) {
+		return std::nullopt;
+	}
+	double weight = .0;
+	for (const EdgeId edge_id : (*route_info).edges) {
+		weight += graph_.GetEdge(edge_id).weight;
+	}
+	return RouteInfo{ weight, std::move((*route_info).edges) };
+}
+
+void TickWeightRouter::PrepareSources(const std::vector<VertexId>& sources, size_t thread_count) {
+	(*router_).PrepareSources(sources, thread_count);
+}
+
+void TransportRouter::PrepareSources(const std::vector<std::string_view>& stops) {
+	if (tree_cache_) {
+		return; // routes don't come from router_, the cache fills as they are asked
+	}
+	std::vector<VertexId> sources;
+	sources.reserve(stops.size());
+	for (const auto stop_name : stops) {
+		if (const auto vertex = FindStopVertex(stop_name)) {
+			sources.push_back(*vertex);
+		}
+	}
+	(*router_).PrepareSources(sources, routing_settings_.router_threads_);
+}
+
+std::vector<std::vector<std::optional<double>>> TransportRouter::GetRouteMatrix(const std::vector<std::string_view>& from,
+	const std::vector<std::string_view>& to) const {
+	// only stops which have vertices take part in the search
+	std::vector<VertexId> sources;
+	std::vector<size_t> source_rows;
+	for (size_t idx = 0; idx < from.size(); ++idx) {
+		if (const auto vertex = FindStopVertex(from[idx])) {
+			sources.push_back(*vertex);
+			source_rows.push_back(idx);
+		}
+	}
+	std::vector<VertexId> targets;
+	std::vector<size_t> target_columns;
+	for (size_t idx = 0; idx < to.size(); ++idx) {
+		if (const auto vertex = FindStopVertex(to[idx])) {
+			targets.push_back(*vertex);
+			target_columns.push_back(idx);
+		}
+	}
+
+	std::vector<std::vector<std::optional<double>>> matrix(from.size(), std::vector<std::optional<double>>(to.size()));
+	if (sources.empty() || targets.empty()) {
+		return matrix;
+	}
+	const auto weights = ComputeRouteWeightMatrix(*graph_, sources, targets, routing_settings_.router_threads_);
+	for (size_t row = 0; row < sources.size(); ++row) {
+		for (size_t column = 0; column < targets.size(); ++column) {
+			matrix[source_rows[row]][target_columns[column]] = weights[row][column];
+		}
+	}
+	return matrix;
+}
+
+std::optional<std::vector<std::pair<std::string_view, double>>> TransportRouter::GetReachableStops(std::string_view from,
+	double max_time) const {
+	const auto from_vertex = FindStopVertex(from);
+	if (!from_vertex) {
+		return std::nullopt;
+	}
+
+	std::vector<std::pair<std::string_view, double>> stops;
+	for (const auto& [vertex, time] : ComputeReachableVertices(*graph_, *from_vertex, max_time)) {
+		if (const Stop* stop = (*vertex_to_stop)[vertex]) {
+			stops.emplace_back(stop->name_, time);
+		}
+	}
+	return stops;
+}
+
+std::optional<VertexId> TransportRouter::FindStopVertex(std::string_view stop_name) const {
+	if (!ts_.CheckStop(stop_name)) {
+		return std::nullopt;
+	}
+	if (const VertexId vertex = (*stop_to_vertex)[ts_.FindStop(stop_name)->id]; vertex != NONE_VERTEX) {
+		return vertex;
+	}
+	return std::nullopt;
+}
+
+std::optional<ShortestPathTreeCache<double>::Statistics> TransportRouter::GetTreeCacheStatistics() const {
+	if (!tree_cache_) {
+		return std::nullopt;
+	}
+	return (*tree_cache_).GetStatistics();
+}
+
 std::optional<const RouteInfo> TransportRouter::GetRouteInfo(std::string_view from, std::string_view to) const {
 
-	const auto& route_info = (*router_).BuildRoute((*stop_to_vertex)[ts_.FindStop(from)], (*stop_to_vertex)[ts_.FindStop(to)]);
+	const auto from_stop_vertex = FindStopVertex(from);
+	const auto to_stop_vertex = FindStopVertex(to);
+	if (!from_stop_vertex || !to_stop_vertex) {
+		return std::nullopt;
+	}
+	const VertexId from_vertex = *from_stop_vertex;
+	const VertexId to_vertex = *to_stop_vertex;
+
+	std::optional<RouterBase<double>::RouteInfo> route_info;
+	if (tree_cache_) {
+		auto tree = (*tree_cache_).Find(from_vertex);
+		if (!tree) {
+			tree = (*tree_cache_).Insert(from_vertex, ShortestPathTree<double>::Build(*graph_, from_vertex));
+		}
+		route_info = (*tree).BuildRoute(*graph_, to_vertex);
+	} else {
+		route_info = (*router_).BuildRoute(from_vertex, to_vertex);
+	}
 	if (!route_info) {
 		return std::nullopt;
 	}
+	return MakeRouteInfo((*route_info).weight, (*route_info).edges);
+}
 
+RouteInfo TransportRouter::MakeRouteInfo(double total_time, const std::vector<EdgeId>& edges) const {
 	RouteInfo info;
-	info.total_time = (*route_info).weight;
-	info.items.reserve((*route_info).edges.size());
+	info.total_time = total_time;
+	info.items.reserve(edges.size() * 2);
+
+	if (routing_settings_.graph_model_ == GraphModel::TRANSIT) {
+		for (const auto& item : edges) {
+			const auto& edge = (*graph_).GetEdge(item);
+			const Stop* from_stop = (*vertex_to_stop)[edge.from];
+			const Stop* to_stop = (*vertex_to_stop)[edge.to];
+			if (from_stop != nullptr && to_stop != nullptr) {
+				info.items.push_back(MakeWalkItem(edge.weight * routing_settings_.walk_velocity_ * KMH_TO_METERS_PER_MINUTE,
+					from_stop, to_stop));
+			} else if (from_stop != nullptr && to_stop == nullptr) {
+				RouteItem item_wait;
+				item_wait.type = RouteReqestType::WAIT;
+				item_wait.time = edge.weight;
+				item_wait.stop_name = from_stop->name_;
+				info.items.push_back(std::move(item_wait));
+			} else if (from_stop == nullptr && to_stop == nullptr) {
+				// consecutive riding edges make one Bus item
+				const auto& [bus, span_count] = (*edge_to_bus_span)[item];
+				if (info.items.empty() || info.items.back().type != RouteReqestType::BUS) {
+					RouteItem item_bus;
+					item_bus.type = RouteReqestType::BUS;
+					item_bus.bus_name = bus->name_;
+					item_bus.span_count = 0;
+					info.items.push_back(std::move(item_bus));
+				}
+				info.items.back().time += edge.weight;
+				*info.items.back().span_count += span_count;
+			}
+			// alighting takes no time and makes no item
+		}
+		return info;
+	}
 
-	for (const auto& item : (*route_info).edges) {
+	for (const auto& item : edges) {
 		const auto& edge = (*graph_).GetEdge(item);
+		const auto& [bus, span_count] = (*edge_to_bus_span)[item];
+		if (bus == nullptr) {
+			info.items.push_back(MakeWalkItem(edge.weight * routing_settings_.walk_velocity_ * KMH_TO_METERS_PER_MINUTE,
+				(*vertex_to_stop)[edge.from], (*vertex_to_stop)[edge.to]));
+			continue;
+		}
 
 		RouteItem item_wait;
 		item_wait.type = RouteReqestType::WAIT;
@@ -33,12 +257,79 @@ std::optional<const RouteInfo> TransportRouter::GetRouteInfo(std::string_view fr
 
 		item_bus.type = RouteReqestType::BUS;
 		item_bus.time = edge.weight - routing_settings_.bus_wait_time_;
-		item_bus.bus_name = (*edge_to_bus_span)[{edge.from, edge.to}].first->name_;
-		item_bus.span_count = (*edge_to_bus_span)[{edge.from, edge.to}].second;
+		item_bus.bus_name = bus->name_;
+		item_bus.span_count = span_count;
 
 		info.items.push_back(std::move(item_bus));
 	}
 	return info;
 }
 
-} // namespace TRouter
\ No newline at end of file
+std::vector<std::pair<VertexId, double>> TransportRouter::FindWalkVertices(geo::Coordinates point,
+	const StopIndex& stop_index) const
+{
+	std::vector<std::pair<VertexId, double>> vertices;
+	for (const auto& [stop, distance] : stop_index.FindWithin(point, routing_settings_.walk_radius_)) {
+		if (stop->id < (*stop_to_vertex).size() && (*stop_to_vertex)[stop->id] != NONE_VERTEX) {
+			vertices.emplace_back((*stop_to_vertex)[stop->id], distance / (routing_settings_.walk_velocity_ * KMH_TO_METERS_PER_MINUTE));
+		}
+	}
+	return vertices;
+}
+
+RouteItem TransportRouter::MakeWalkItem(double distance, const Stop* from_stop, const Stop* to_stop) const {
+	RouteItem item_walk;
+	item_walk.type = RouteReqestType::WALK;
+	item_walk.time = distance / (routing_settings_.walk_velocity_ * KMH_TO_METERS_PER_MINUTE);
+	item_walk.distance = distance;
+	if (from_stop != nullptr) {
+		item_walk.stop_name = from_stop->name_;
+	}
+	if (to_stop != nullptr) {
+		item_walk.to_stop_name = to_stop->name_;
+	}
+	return item_walk;
+}
+
+std::optional<const RouteInfo> TransportRouter::GetRouteInfo(geo::Coordinates from, geo::Coordinates to,
+	const StopIndex& stop_index) const
+{
+	const double meters_per_minute = routing_settings_.walk_velocity_ * KMH_TO_METERS_PER_MINUTE;
+	const auto sources = FindWalkVertices(from, stop_index);
+	const auto targets = FindWalkVertices(to, stop_index);
+	const auto route_info = BuildMultiRoute(*graph_, sources, targets);
+
+	// two points no farther than a walk to a stop and a walk from one may be closer on foot
+	const double walk_distance = geo::ComputeDistance(from, to);
+	if (walk_distance <= 2 * routing_settings_.walk_radius_
+		&& (!route_info || walk_distance / meters_per_minute <= (*route_info).weight))
+	{
+		return RouteInfo{ walk_distance / meters_per_minute, { MakeWalkItem(walk_distance, nullptr, nullptr) } };
+	}
+	if (!route_info) {
+		return std::nullopt;
+	}
+
+	// walks are timed as the search weighed them, so the items add up to the total; a point right at
+	// its stop makes no walk
+	const auto walk_time = [](const std::vector<std::pair<VertexId, double>>& vertices, VertexId vertex) {
+		return std::find_if(vertices.begin(), vertices.end(), [vertex](const auto& item) {
+			return item.first == vertex;
+		})->second;
+	};
+	const double access_time = walk_time(sources, (*route_info).from);
+	const double egress_time = walk_time(targets, (*route_info).to);
+
+	RouteInfo info = MakeRouteInfo((*route_info).weight, (*route_info).edges);
+	if (access_time > .0) {
+		info.items.insert(info.items.begin(), MakeWalkItem(access_time * meters_per_minute,
+			nullptr, (*vertex_to_stop)[(*route_info).from]));
+	}
+	if (egress_time > .0) {
+		info.items.push_back(MakeWalkItem(egress_time * meters_per_minute,
+			(*vertex_to_stop)[(*route_info).to], nullptr));
+	}
+	return info;
+}
+
+} // namespace TRouter
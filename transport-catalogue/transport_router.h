@@ -3,10 +3,19 @@
 #include "transport_catalogue.h"
 #include "domain.h"
 #include "router.h"
+#include "dijkstra_router.h"
+#include "contraction_hierarchy.h"
+#include "astar_router.h"
+#include "bidirectional_router.h"
+#include "shortest_path_tree.h"
+#include "vertex_order.h"
+#include "stop_index.h"
 #include "graph.h"
 
+#include <limits>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace TRouter {
 
@@ -16,19 +25,101 @@ using namespace domain;
 
 using namespace std::literals;
 
-using Stop_VertexId = std::unordered_map<const Stop*, VertexId>;
-using VertexId_Stop = std::unordered_map<VertexId, const Stop*>;
-using Edge_BusSpan = std::unordered_map<std::pair<VertexId, VertexId>, std::pair<const Bus*, size_t>, HacherPair>;
+inline constexpr VertexId NONE_VERTEX = std::numeric_limits<VertexId>::max();
+
+using Stop_VertexId = std::vector<VertexId>; // indexed by stop id, NONE_VERTEX for stops on no bus
+using VertexId_Stop = std::vector<const Stop*>; // indexed by vertex id, nullptr for vertices which aren't stops
+using Edge_BusSpan = std::vector<std::pair<const Bus*, size_t>>; // indexed by edge id, nullptr bus for edges which aren't rides
+
+// engine which answers BuildRoute: full all-pairs table or lazy per-query search
+enum class RouterType {
+	ALL_PAIRS,
+	DIJKSTRA,
+	CONTRACTION_HIERARCHY,
+	A_STAR,
+	BIDIRECTIONAL,
+	SHORTEST_PATH_TREES
+};
+
+// how buses become graph edges: an edge from every stop of a bus to every later one, or
+// a stop vertex per stop plus a vertex per stop of each bus route joined by boarding (weighs
+// the wait), riding (one stretch between neighbour stops) and alighting (free) edges
+enum class GraphModel {
+	STOP_PAIRS,
+	TRANSIT
+};
+
+// vertex numbering of the graph: as stops are met on routes, or renumbered by make_base for locality,
+// by a Cuthill-McKee search over the graph or along a Hilbert curve over stop coordinates
+enum class VertexOrder {
+	ROUTES,
+	CUTHILL_MCKEE,
+	HILBERT
+};
 
 struct RoutingSettings {
     double bus_wait_time_ = .0;
     double bus_velocity_ = .0;
+    RouterType router_type_ = RouterType::ALL_PAIRS;
+    size_t router_threads_ = 1; // threads building the graph, precomputing routes and answering them, zero means all hardware threads
+    bool store_routing_table_ = false; // all-pairs table is computed by make_base and kept in the base
+    size_t tree_cache_size_mb_ = 0; // budget of the shortest-path tree cache, zero turns the cache off
+    GraphModel graph_model_ = GraphModel::STOP_PAIRS;
+    VertexOrder vertex_order_ = VertexOrder::ROUTES;
+    size_t weight_ticks_per_minute_ = 0; // routes are searched over weights in integer ticks, zero keeps doubles
+    double walk_velocity_ = 5.; // km/h, routes between coordinates walk to the first stop and from the last one
+    double walk_radius_ = 500.; // meters, the farthest stop such a route walks to
+    double transfer_radius_ = .0; // meters, make_base joins stops this close by walking edges, zero adds none
+};
+
+using TickWeight = uint32_t;
+using TickGraph = DirectedWeightedGraph<TickWeight>;
+
+// frozen copy of the graph with weights rounded to the nearest of ticks_per_minute ticks; throws
+// std::domain_error if a route of vertex count edges of the heaviest weight may overflow TickWeight
+TickGraph MakeTickGraph(const DirectedWeightedGraph<double>& graph, size_t ticks_per_minute);
+
+// Searches routes with an engine over the tick graph: 32-bit weights halve the all-pairs table and
+// let searches use a radix heap. A route weight is summed from the double weights of its edges, so totals
+// keep full precision; a route may be longer than the shortest one by up to half a tick per edge.
+class TickWeightRouter final : public RouterBase<double> {
+public:
+	TickWeightRouter(const DirectedWeightedGraph<double>& graph, std::unique_ptr<TickGraph>&& tick_graph,
+		std::unique_ptr<RouterBase<TickWeight>>&& router);
+
+	std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+	void PrepareSources(const std::vector<VertexId>& sources, size_t thread_count) override;
+
+private:
+	const DirectedWeightedGraph<double>& graph_;
+	std::unique_ptr<TickGraph> tick_graph_; // the engine refers to it
+	std::unique_ptr<RouterBase<TickWeight>> router_;
+};
+
+// A* potential: any route from a stop to a different stop waits at least once, and rides no less than
+// the great-circle distance scaled by the smallest road to great-circle ratio over the graph edges,
+// so the bound stays admissible whatever road distances are. With walking transfers a route may not wait
+// at all, so the wait is left out and walks count among the edges. Coordinates are indexed by vertex id,
+// vertices which are not stops (the ones on a bus) are placed at the stop where the bus is.
+class StopDistancePotential {
+public:
+	StopDistancePotential(std::vector<geo::Coordinates>&& vertex_coordinates, std::vector<bool>&& stop_vertices,
+		const DirectedWeightedGraph<double>& graph, const Edge_BusSpan& edge_to_bus_span, const RoutingSettings& routing_settings);
+
+	double operator()(VertexId vertex, VertexId to) const;
+
+private:
+	std::vector<geo::Coordinates> vertex_coordinates_;
+	std::vector<bool> stop_vertices_;
+	double bus_wait_time_ = .0;
+	double minutes_per_meter_ = .0; // great-circle meters to the least possible ride time
 };
 
 enum class RouteReqestType {
 	NONE,
 	WAIT,
-	BUS
+	BUS,
+	WALK
 };
 
 // need class structure, with general class and two classes with relevant request type
@@ -41,6 +132,10 @@ struct RouteItem {
 
 	std::optional<std::string_view> bus_name;
 	std::optional<size_t> span_count;
+
+	// meters walked; a walk goes from stop_name to to_stop_name, either is none where the walk starts or ends at a point
+	std::optional<double> distance;
+	std::optional<std::string_view> to_stop_name;
 };
 
 struct RouteInfo 
@@ -54,7 +149,7 @@ public:
 	using graph = DirectedWeightedGraph<double>;
 
 	TransportRouter(std::unique_ptr<graph>&& graph, 
-		std::unique_ptr<Router<double>>&& router, 
+		std::unique_ptr<RouterBase<double>>&& router, 
 		std::unique_ptr<Stop_VertexId>&& vertex_ids,
 		std::unique_ptr<Edge_BusSpan>&& span_counts,
 		std::unique_ptr<VertexId_Stop>&& id_stop,
@@ -66,15 +161,41 @@ public:
 		edge_to_bus_span(std::move(span_counts)),
 		vertex_to_stop(std::move(id_stop)),
 		ts_(ts), 
-		routing_settings_(routing_settings)
+		routing_settings_(routing_settings),
+		tree_cache_(routing_settings.tree_cache_size_mb_ > 0
+			? std::make_unique<ShortestPathTreeCache<double>>(routing_settings.tree_cache_size_mb_ << 20)
+			: nullptr)
 	{
 	}
 
 	std::optional<const RouteInfo> GetRouteInfo(std::string_view from, std::string_view to) const;
 
+	// best route between two points: a walk to a stop within walk_radius_ of from, buses, and a walk from
+	// a stop within walk_radius_ of to, or a walk all the way when the points are close and it's no slower;
+	// nullopt when there is no such route. Whatever the engine, one Dijkstra over the graph is seeded
+	// by the walks, so no vertices are added for the points and queries may run concurrently
+	std::optional<const RouteInfo> GetRouteInfo(geo::Coordinates from, geo::Coordinates to,
+		const StopIndex& stop_index) const;
+
+	// lets the router precompute routes from the stops which are going to be asked
+	void PrepareSources(const std::vector<std::string_view>& stops);
+
+	// total times of the best routes from every stop of from to every stop of to, nullopt where
+	// there is no route or the stop isn't served by buses
+	std::vector<std::vector<std::optional<double>>> GetRouteMatrix(const std::vector<std::string_view>& from,
+		const std::vector<std::string_view>& to) const;
+
+	// stops whose best routes from the stop take no more than max_time, with those times
+	// in increasing order, the stop itself included; nullopt when the stop isn't served by buses
+	std::optional<std::vector<std::pair<std::string_view, double>>> GetReachableStops(std::string_view from,
+		double max_time) const;
+
+	// hits, misses and memory of the tree cache, nullopt when the cache is off
+	std::optional<ShortestPathTreeCache<double>::Statistics> GetTreeCacheStatistics() const;
+
 private:
 	std::unique_ptr<graph> graph_ = nullptr;
-	std::unique_ptr<Router<double>> router_ = nullptr;
+	std::unique_ptr<RouterBase<double>> router_ = nullptr;
 
 	std::unique_ptr<Stop_VertexId> stop_to_vertex = nullptr;
 	std::unique_ptr<VertexId_Stop> vertex_to_stop = nullptr;
@@ -83,6 +204,20 @@ private:
 
 	const Catalogue::TransportCatalogue& ts_;
 	const RoutingSettings routing_settings_;
+
+	// when set, routes are walked in cached full trees of their sources instead of asking router_
+	std::unique_ptr<ShortestPathTreeCache<double>> tree_cache_ = nullptr;
+
+	std::optional<VertexId> FindStopVertex(std::string_view stop_name) const;
+
+	// Wait and Bus items of a route over the graph edges
+	RouteInfo MakeRouteInfo(double total_time, const std::vector<EdgeId>& edges) const;
+
+	// vertices of the stops within walk_radius_ of the point, weighted by the time to walk there
+	std::vector<std::pair<VertexId, double>> FindWalkVertices(geo::Coordinates point, const StopIndex& stop_index) const;
+
+	// Walk item of distance meters between the stops, nullptr for a point
+	RouteItem MakeWalkItem(double distance, const Stop* from_stop, const Stop* to_stop) const;
 };
 
 } // namespace TRouter
\ No newline at end of file
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Vertex renumberings which give vertices close to each other nearby ids, so searches and rows of the
+// all-pairs table touch fewer cache lines. Both return new vertex ids indexed by the old ones.
+
+// Cuthill-McKee: breadth-first search with edge directions ignored, which starts every connected
+// component at a vertex of the least degree and visits the neighbours of a vertex by ascending degree
+template <typename Weight>
+std::vector<VertexId> ComputeCuthillMcKeeOrder(const DirectedWeightedGraph<Weight>& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    const size_t edge_count = graph.GetEdgeCount();
+
+    // undirected adjacency in compressed rows
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        ++offsets[edge.from + 1];
+        ++offsets[edge.to + 1];
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<VertexId> neighbours(offsets.back());
+    {
+        std::vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        for (EdgeId edge_id = 0; edge_id < edge_count; ++edge_id) {
+            const auto& edge = graph.GetEdge(edge_id);
+            neighbours[positions[edge.from]++] = edge.to;
+            neighbours[positions[edge.to]++] = edge.from;
+        }
+    }
+
+    const auto is_less_degree = [&offsets](VertexId lhs, VertexId rhs) {
+        return std::make_pair(offsets[lhs + 1] - offsets[lhs], lhs) < std::make_pair(offsets[rhs + 1] - offsets[rhs], rhs);
+    };
+    std::vector<VertexId> vertices_by_degree(vertex_count);
+    std::iota(vertices_by_degree.begin(), vertices_by_degree.end(), 0);
+    std::sort(vertices_by_degree.begin(), vertices_by_degree.end(), is_less_degree);
+
+    std::vector<VertexId> order;
+    order.reserve(vertex_count);
+    std::vector<bool> is_visited(vertex_count, false);
+    for (const VertexId start : vertices_by_degree) {
+        if (is_visited[start]) {
+            continue;
+        }
+        is_visited[start] = true;
+        order.push_back(start);
+        // order grows while it's scanned: its tail is the queue of the search
+        for (size_t idx = order.size() - 1; idx < order.size(); ++idx) {
+            const VertexId vertex = order[idx];
+            const size_t first_new = order.size();
+            for (size_t pos = offsets[vertex]; pos < offsets[vertex + 1]; ++pos) {
+                if (const VertexId next = neighbours[pos]; !is_visited[next]) {
+                    is_visited[next] = true;
+                    order.push_back(next);
+                }
+            }
+            std::sort(order.begin() + first_new, order.end(), is_less_degree);
+        }
+    }
+
+    std::vector<VertexId> new_ids(vertex_count);
+    for (size_t idx = 0; idx < vertex_count; ++idx) {
+        new_ids[order[idx]] = idx;
+    }
+    return new_ids;
+}
+
+// Order of points (x, y) of the vertices along a Hilbert curve filling their bounding box:
+// points close on the curve are close on the plane
+inline std::vector<VertexId> ComputeHilbertOrder(const std::vector<std::pair<double, double>>& points) {
+    constexpr uint32_t GRID_SIZE = 1u << 16;
+    const size_t vertex_count = points.size();
+
+    double min_x = .0, max_x = .0, min_y = .0, max_y = .0;
+    if (vertex_count > 0) {
+        min_x = max_x = points.front().first;
+        min_y = max_y = points.front().second;
+    }
+    for (const auto& [x, y] : points) {
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+    }
+    const auto to_grid = [](double value, double min_value, double max_value) {
+        return max_value > min_value
+            ? static_cast<uint32_t>((value - min_value) / (max_value - min_value) * (GRID_SIZE - 1))
+            : 0u;
+    };
+
+    // distance along the curve of a grid cell, rotating the quadrants level by level
+    const auto get_hilbert_index = [](uint32_t x, uint32_t y) {
+        uint64_t index = 0;
+        for (uint32_t side = GRID_SIZE / 2; side > 0; side /= 2) {
+            const uint32_t rx = (x & side) > 0 ? 1 : 0;
+            const uint32_t ry = (y & side) > 0 ? 1 : 0;
+            index += static_cast<uint64_t>(side) * side * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = GRID_SIZE - 1 - x;
+                    y = GRID_SIZE - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return index;
+    };
+
+    std::vector<std::pair<uint64_t, VertexId>> keys;
+    keys.reserve(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        const auto& [x, y] = points[vertex];
+        keys.emplace_back(get_hilbert_index(to_grid(x, min_x, max_x), to_grid(y, min_y, max_y)), vertex);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<VertexId> new_ids(vertex_count);
+    for (size_t idx = 0; idx < vertex_count; ++idx) {
+        new_ids[keys[idx].second] = idx;
+    }
+    return new_ids;
+}
+
+}  // namespace graph